@@ -0,0 +1,282 @@
+#include "Autotuner.h"
+
+#include "GemmBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+namespace {
+    // Values of subgroupsM, subgroupsN, tilesM and tilesN.
+    constexpr uint32_t kAutotuneBlockFactors[] = { 1, 2, 4 };
+    constexpr uint32_t kAutotuneFirstRepetitions = 4;
+    // Candidates this many times slower than the fastest one of a round are dropped whatever their rank.
+    constexpr double kAutotunePruneFactor = 2.0;
+    // Files of another version are read as empty databases.
+    constexpr uint32_t kAutotuneDatabaseVersion = 1;
+
+    uint32_t RoundUpToPowerOfTwo(uint32_t value) {
+        uint32_t power = 1;
+        while (power < value && power < (1u << 31)) {
+            power *= 2;
+        }
+        return power;
+    }
+
+    bool IsSameDevice(const JsonValue& device1, const JsonValue& device2) {
+        for (const char* key : { "vendorID", "deviceID", "driverVersion" }) {
+            if (device1.GetNumber(key, -1.0) != device2.GetNumber(key, -1.0)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IsSameKey(const AutotuneKey& key1, const AutotuneKey& key2) {
+        return key1.type == key2.type && key1.tile == key2.tile && key1.features == key2.features &&
+            key1.shapeClass == key2.shapeClass;
+    }
+}  // anonymous namespace
+
+std::vector<GemmKernelConfig> GetAutotuneCandidates(
+    const VulkanRuntime& vulkanRuntime, const GemmKernelConfig& baseConfig) {
+    // The widest subgroup the device may launch, which GemmKernel uses when it cannot pin the subgroup size.
+    uint32_t subgroupSize = std::max(
+        vulkanRuntime.GetVulkan11Properties().subgroupSize, vulkanRuntime.GetVulkan13Properties().maxSubgroupSize);
+    uint32_t maxInvocations = vulkanRuntime.GetPhysicalDeviceProperties().limits.maxComputeWorkGroupInvocations;
+    std::vector<GemmKernelConfig> candidates;
+    for (bool stageInShared : { false, true }) {
+        // Packed 4-bit weights are only unpacked while staged.
+        if (!stageInShared && baseConfig.int4GroupSize != 0) {
+            continue;
+        }
+        for (uint32_t subgroupsM : kAutotuneBlockFactors) {
+            for (uint32_t subgroupsN : kAutotuneBlockFactors) {
+                if (subgroupSize * subgroupsM * subgroupsN > maxInvocations) {
+                    continue;
+                }
+                for (uint32_t tilesM : kAutotuneBlockFactors) {
+                    for (uint32_t tilesN : kAutotuneBlockFactors) {
+                        GemmKernelConfig config = baseConfig;
+                        config.stageInShared = stageInShared;
+                        config.subgroupsM = subgroupsM;
+                        config.subgroupsN = subgroupsN;
+                        config.tilesM = tilesM;
+                        config.tilesN = tilesN;
+                        candidates.push_back(config);
+                    }
+                }
+            }
+        }
+    }
+    return candidates;
+}
+
+AutotuneKey MakeAutotuneKey(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape, const BenchmarkOptions& options) {
+    AutotuneKey key;
+    key.type = GemmKernel::GetShaderVariantName(property);
+    key.tile = std::to_string(property.MSize) + "x" + std::to_string(property.NSize) + "x" +
+        std::to_string(property.KSize);
+    std::string kernelName = GemmKernel::GetKernelName(options.kernelConfig);
+    size_t separator = kernelName.find('_');
+    key.features = separator == std::string::npos ? "" : kernelName.substr(separator + 1);
+    if (options.splitK != 1) {
+        key.features += std::string(key.features.empty() ? "" : "_") + "split" +
+            (options.splitK == 0 ? "auto" : std::to_string(options.splitK));
+    }
+    GemmShape shapeClass = {
+        RoundUpToPowerOfTwo(shape.m), RoundUpToPowerOfTwo(shape.n), RoundUpToPowerOfTwo(shape.k),
+        RoundUpToPowerOfTwo(shape.batch) };
+    key.shapeClass = GetShapeName(shapeClass);
+    if (options.groupCount > 0) {
+        key.shapeClass += "g" + std::to_string(options.groupCount);
+    }
+    return key;
+}
+
+std::string GetAutotuneParameterName(const GemmKernelConfig& config) {
+    return std::string(config.stageInShared ? "shared " : "direct ") + std::to_string(config.subgroupsM) + "x" +
+        std::to_string(config.subgroupsN) + " subgroups " + std::to_string(config.tilesM) + "x" +
+        std::to_string(config.tilesN) + " tiles";
+}
+
+AutotuneDatabase::AutotuneDatabase(const VulkanRuntime& vulkanRuntime)
+    : mDevice(MakeDeviceJson(&vulkanRuntime)) {}
+
+bool AutotuneDatabase::Load(const std::string& path) {
+    mEntries.clear();
+    mOtherDevices.clear();
+    if (!std::ifstream(path).is_open()) {
+        return true;
+    }
+    JsonValue database;
+    std::string error;
+    if (!ReadJsonFile(path, &database, &error)) {
+        std::cerr << "Failed to read autotuning database: " << error << std::endl;
+        return false;
+    }
+    if (database.GetNumber("version", 0.0) != kAutotuneDatabaseVersion) {
+        return true;
+    }
+    const JsonValue* devices = database.Find("devices");
+    if (devices == nullptr) {
+        return true;
+    }
+    for (const JsonValue& record : devices->AsArray()) {
+        const JsonValue* device = record.Find("device");
+        const JsonValue* entries = record.Find("entries");
+        if (device == nullptr || entries == nullptr || !IsSameDevice(*device, mDevice)) {
+            mOtherDevices.push_back(record);
+            continue;
+        }
+        for (const JsonValue& json : entries->AsArray()) {
+            AutotuneEntry entry;
+            entry.key.type = json.GetString("type", "");
+            entry.key.tile = json.GetString("tile", "");
+            entry.key.features = json.GetString("features", "");
+            entry.key.shapeClass = json.GetString("shapeClass", "");
+            entry.config.subgroupsM = static_cast<uint32_t>(json.GetNumber("subgroupsM", 1.0));
+            entry.config.subgroupsN = static_cast<uint32_t>(json.GetNumber("subgroupsN", 1.0));
+            entry.config.tilesM = static_cast<uint32_t>(json.GetNumber("tilesM", 1.0));
+            entry.config.tilesN = static_cast<uint32_t>(json.GetNumber("tilesN", 1.0));
+            const JsonValue* stageInShared = json.Find("stageInShared");
+            entry.config.stageInShared = stageInShared != nullptr && stageInShared->AsBool();
+            entry.shape = json.GetString("shape", "");
+            entry.medianNanoseconds = json.GetNumber("medianNanoseconds", 0.0);
+            entry.candidateCount = static_cast<uint32_t>(json.GetNumber("candidates", 0.0));
+            if (entry.config.subgroupsM == 0 || entry.config.subgroupsN == 0 || entry.config.tilesM == 0 ||
+                entry.config.tilesN == 0) {
+                continue;
+            }
+            mEntries.push_back(entry);
+        }
+    }
+    return true;
+}
+
+bool AutotuneDatabase::Save(const std::string& path) const {
+    JsonValue database = JsonValue::MakeObject();
+    database["version"] = kAutotuneDatabaseVersion;
+    JsonValue& devices = database["devices"] = JsonValue::MakeArray();
+    for (const JsonValue& record : mOtherDevices) {
+        devices.Append(record);
+    }
+    JsonValue record = JsonValue::MakeObject();
+    record["device"] = mDevice;
+    JsonValue& entries = record["entries"] = JsonValue::MakeArray();
+    for (const AutotuneEntry& entry : mEntries) {
+        JsonValue json = JsonValue::MakeObject();
+        json["type"] = entry.key.type;
+        json["tile"] = entry.key.tile;
+        json["features"] = entry.key.features;
+        json["shapeClass"] = entry.key.shapeClass;
+        json["subgroupsM"] = entry.config.subgroupsM;
+        json["subgroupsN"] = entry.config.subgroupsN;
+        json["tilesM"] = entry.config.tilesM;
+        json["tilesN"] = entry.config.tilesN;
+        json["stageInShared"] = entry.config.stageInShared;
+        json["shape"] = entry.shape;
+        json["medianNanoseconds"] = entry.medianNanoseconds;
+        json["candidates"] = entry.candidateCount;
+        entries.Append(std::move(json));
+    }
+    devices.Append(std::move(record));
+    return WriteJsonFile(path, database);
+}
+
+bool AutotuneDatabase::Find(const AutotuneKey& key, GemmKernelConfig* config) const {
+    for (const AutotuneEntry& entry : mEntries) {
+        if (IsSameKey(entry.key, key)) {
+            config->subgroupsM = entry.config.subgroupsM;
+            config->subgroupsN = entry.config.subgroupsN;
+            config->tilesM = entry.config.tilesM;
+            config->tilesN = entry.config.tilesN;
+            config->stageInShared = entry.config.stageInShared;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AutotuneDatabase::Store(const AutotuneEntry& entry) {
+    for (AutotuneEntry& existing : mEntries) {
+        if (IsSameKey(existing.key, entry.key)) {
+            existing = entry;
+            return;
+        }
+    }
+    mEntries.push_back(entry);
+}
+
+bool AutotuneGemmKernel(
+    VulkanRuntime& vulkanRuntime, PipelineRegistry& pipelineRegistry, const VkCooperativeMatrixPropertiesKHR& property,
+    const GemmShape& shape, const BenchmarkOptions& options, AutotuneEntry* entry) {
+    struct Candidate {
+        std::unique_ptr<GemmKernel> gemmKernel;
+        double medianNanoseconds;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<GemmKernel*> pendingKernels;
+    for (const GemmKernelConfig& config : GetAutotuneCandidates(vulkanRuntime, options.kernelConfig)) {
+        auto gemmKernel = std::make_unique<GemmKernel>(vulkanRuntime, property, config);
+        if (!gemmKernel->IsShapeSupported(shape)) {
+            continue;
+        }
+        pendingKernels.push_back(gemmKernel.get());
+        candidates.push_back({ std::move(gemmKernel), 0.0 });
+    }
+    entry->key = MakeAutotuneKey(property, shape, options);
+    entry->shape = GetShapeName(shape);
+    entry->candidateCount = static_cast<uint32_t>(candidates.size());
+    if (candidates.empty()) {
+        return false;
+    }
+    printf("Autotuning %s/%s/%s/%s: %zu candidates\n", entry->key.type.c_str(), entry->key.tile.c_str(),
+        entry->key.shapeClass.c_str(), GemmKernel::GetKernelName(options.kernelConfig).c_str(), candidates.size());
+    GemmKernel::CreatePipelines(pipelineRegistry, pendingKernels);
+
+    // Only the first round verifies; the survivors are measured again with more repetitions.
+    BenchmarkOptions roundOptions = options;
+    roundOptions.printResult = false;
+    roundOptions.measureTransfers = false;
+    roundOptions.repetitions = std::min(kAutotuneFirstRepetitions, options.repetitions);
+    for (uint32_t round = 1;; ++round) {
+        for (Candidate& candidate : candidates) {
+            BenchmarkResult result = options.groupCount > 0 ?
+                RunGroupedGemmBenchmark(vulkanRuntime, *candidate.gemmKernel, shape, roundOptions) :
+                RunGemmBenchmark(vulkanRuntime, *candidate.gemmKernel, shape, roundOptions);
+            candidate.medianNanoseconds =
+                result.verified ? result.kernelNanoseconds.median : std::numeric_limits<double>::infinity();
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& c1, const Candidate& c2) {
+            return c1.medianNanoseconds < c2.medianNanoseconds;
+        });
+        double bestNanoseconds = candidates.front().medianNanoseconds;
+        if (std::isinf(bestNanoseconds)) {
+            printf("  no candidate produced correct results\n");
+            return false;
+        }
+        auto slow = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& candidate) {
+            return candidate.medianNanoseconds > bestNanoseconds * kAutotunePruneFactor;
+        });
+        candidates.erase(slow, candidates.end());
+        candidates.erase(candidates.begin() + (candidates.size() + 1) / 2, candidates.end());
+        printf("  round %u: %u repetitions, best %.3f ms with %s, %zu left\n", round, roundOptions.repetitions,
+            bestNanoseconds * 1e-6, GetAutotuneParameterName(candidates.front().gemmKernel->GetConfig()).c_str(),
+            candidates.size());
+        if (candidates.size() == 1) {
+            break;
+        }
+        roundOptions.verificationTrials = 0;
+        roundOptions.repetitions = std::max(roundOptions.repetitions, std::min(2 * roundOptions.repetitions,
+            options.repetitions));
+    }
+    entry->config = candidates.front().gemmKernel->GetConfig();
+    entry->medianNanoseconds = candidates.front().medianNanoseconds;
+    return true;
+}
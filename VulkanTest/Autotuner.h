@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef AUTOTUNER_H_
+#define AUTOTUNER_H_
+
+#include "Benchmark.h"
+#include "GemmKernel.h"
+#include "Json.h"
+#include "PipelineRegistry.h"
+
+// The searched parameters are subgroupsM, subgroupsN, tilesM, tilesN and stageInShared; the rest of a configuration
+// comes from the options. Returns every combination the device can launch.
+std::vector<GemmKernelConfig> GetAutotuneCandidates(
+    const VulkanRuntime& vulkanRuntime, const GemmKernelConfig& baseConfig);
+
+// A tuned configuration within the record of one device.
+struct AutotuneKey {
+    // GemmKernel::GetShaderVariantName() and the cooperative matrix tile, "MxNxK".
+    std::string type;
+    std::string tile;
+    // What the options ask of the kernel besides the searched parameters: GemmKernel::GetKernelName() without
+    // "direct" or "shared", plus "split" and the split-K factor or "auto".
+    std::string features;
+    // Shapes whose dimensions and batch size round up to the same powers of two share a configuration, e.g.
+    // "2048x2048x1024", and grouped runs add "g" and the group count.
+    std::string shapeClass;
+};
+
+AutotuneKey MakeAutotuneKey(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape, const BenchmarkOptions& options);
+
+struct AutotuneEntry {
+    AutotuneKey key;
+    // Only the searched parameters are stored.
+    GemmKernelConfig config;
+    // The shape the search ran on and the median kernel time of the winner in its last round.
+    std::string shape;
+    double medianNanoseconds = 0.0;
+    uint32_t candidateCount = 0;
+};
+
+// e.g. "shared 2x2 subgroups 2x1 tiles".
+std::string GetAutotuneParameterName(const GemmKernelConfig& config);
+
+// Tuned configurations in a JSON file that may hold several devices: one record per device, matched by vendor
+// ID, device ID and driver version as MakeDeviceJson() writes them, so a driver update starts from scratch.
+// Records of other devices are written back unchanged.
+class AutotuneDatabase {
+  public:
+    explicit AutotuneDatabase(const VulkanRuntime& vulkanRuntime);
+
+    // A missing file loads as an empty database.
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    // Copies the searched parameters of the entry for key into config.
+    bool Find(const AutotuneKey& key, GemmKernelConfig* config) const;
+    // Replaces the entry with the same key.
+    void Store(const AutotuneEntry& entry);
+
+  private:
+    JsonValue mDevice;
+    std::vector<AutotuneEntry> mEntries;
+    std::vector<JsonValue> mOtherDevices;
+};
+
+// Searches the candidates of options.kernelConfig for shape in rounds of RunGemmBenchmark(), or
+// RunGroupedGemmBenchmark() with options.groupCount, timed like any other benchmark. Each round drops the
+// candidates that fail verification or take more than twice as long as the fastest, keeps the faster half
+// of the rest and doubles the repetitions, up to options.repetitions, until one is left. Returns false when
+// no candidate supports the shape.
+bool AutotuneGemmKernel(
+    VulkanRuntime& vulkanRuntime, PipelineRegistry& pipelineRegistry, const VkCooperativeMatrixPropertiesKHR& property,
+    const GemmShape& shape, const BenchmarkOptions& options, AutotuneEntry* entry);
+
+#endif
@@ -0,0 +1,584 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace {
+    bool ParseUnsigned(const char* text, uint32_t* value) {
+        // strtoull() skips whitespace and accepts a sign, negating the value modulo 2^64.
+        if (!isdigit(static_cast<unsigned char>(text[0]))) {
+            return false;
+        }
+        errno = 0;
+        char* end = nullptr;
+        unsigned long long parsed = strtoull(text, &end, 10);
+        if (*end != '\0' || errno == ERANGE || parsed > UINT32_MAX) {
+            return false;
+        }
+        *value = static_cast<uint32_t>(parsed);
+        return true;
+    }
+
+    std::vector<std::string> SplitList(const std::string& text) {
+        std::vector<std::string> items;
+        size_t begin = 0;
+        while (begin <= text.size()) {
+            size_t end = text.find(',', begin);
+            if (end == std::string::npos) {
+                end = text.size();
+            }
+            if (end > begin) {
+                items.push_back(text.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+        return items;
+    }
+
+    // "MxNxK", e.g. "4096x4096x4096".
+    bool ParseShape(const std::string& text, GemmShape* shape) {
+        size_t first = text.find('x');
+        size_t second = first == std::string::npos ? std::string::npos : text.find('x', first + 1);
+        if (second == std::string::npos) {
+            return false;
+        }
+        uint32_t m = 0;
+        uint32_t n = 0;
+        uint32_t k = 0;
+        if (!ParseUnsigned(text.substr(0, first).c_str(), &m) ||
+            !ParseUnsigned(text.substr(first + 1, second - first - 1).c_str(), &n) ||
+            !ParseUnsigned(text.substr(second + 1).c_str(), &k)) {
+            return false;
+        }
+        *shape = { m, n, k };
+        return true;
+    }
+
+    double Percentile(const std::vector<double>& sortedSamples, double percentile) {
+        double position = percentile * static_cast<double>(sortedSamples.size() - 1);
+        size_t lower = static_cast<size_t>(std::floor(position));
+        size_t upper = std::min(lower + 1, sortedSamples.size() - 1);
+        double fraction = position - static_cast<double>(lower);
+        return sortedSamples[lower] + (sortedSamples[upper] - sortedSamples[lower]) * fraction;
+    }
+
+    std::string FormatApiVersion(uint32_t apiVersion) {
+        return std::to_string(VK_API_VERSION_MAJOR(apiVersion)) + "." +
+            std::to_string(VK_API_VERSION_MINOR(apiVersion)) + "." +
+            std::to_string(VK_API_VERSION_PATCH(apiVersion));
+    }
+
+    JsonValue MakeStatisticsJson(const BenchmarkStatistics& statistics) {
+        JsonValue json = JsonValue::MakeObject();
+        json["min"] = statistics.min;
+        json["median"] = statistics.median;
+        json["p90"] = statistics.p90;
+        json["p99"] = statistics.p99;
+        json["mean"] = statistics.mean;
+        return json;
+    }
+}  // anonymous namespace
+
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions* options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* argument = argv[i];
+        if (strcmp(argument, "--print-result") == 0) {
+            options->printResult = true;
+            continue;
+        }
+        if (strcmp(argument, "--sweep") == 0) {
+            options->sweep = true;
+            continue;
+        }
+        if (strcmp(argument, "--rerecord") == 0) {
+            options->replayCommandBuffers = false;
+            continue;
+        }
+        if (strcmp(argument, "--device-address") == 0) {
+            options->kernelConfig.deviceAddress = true;
+            continue;
+        }
+        if (strcmp(argument, "--bias") == 0) {
+            options->kernelConfig.epilogue.bias = true;
+            continue;
+        }
+        if (strcmp(argument, "--retune") == 0) {
+            options->retune = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argument, "--shape") == 0) {
+            for (const std::string& item : SplitList(value)) {
+                GemmShape shape;
+                if (!ParseShape(item, &shape)) {
+                    return false;
+                }
+                options->shapes.push_back(shape);
+            }
+        } else if (strcmp(argument, "--batch") == 0) {
+            for (const std::string& item : SplitList(value)) {
+                uint32_t batchSize = 0;
+                if (!ParseUnsigned(item.c_str(), &batchSize) || batchSize == 0) {
+                    return false;
+                }
+                options->batchSizes.push_back(batchSize);
+            }
+        } else if (strcmp(argument, "--groups") == 0) {
+            if (!ParseUnsigned(value, &options->groupCount)) {
+                return false;
+            }
+            options->kernelConfig.grouped = options->groupCount > 0;
+        } else if (strcmp(argument, "--split-k") == 0) {
+            if (strcmp(value, "auto") == 0) {
+                options->splitK = 0;
+            } else if (!ParseUnsigned(value, &options->splitK) || options->splitK == 0) {
+                return false;
+            }
+            options->kernelConfig.splitK = options->splitK != 1;
+        } else if (strcmp(argument, "--activation") == 0) {
+            GemmEpilogueParameters& parameters = options->epilogueParameters;
+            char trailing = 0;
+            if (strcmp(value, "none") == 0) {
+                options->kernelConfig.epilogue.activation = GemmActivation::None;
+            } else if (strcmp(value, "relu") == 0) {
+                options->kernelConfig.epilogue.activation = GemmActivation::Relu;
+            } else if (sscanf(value, "clamp:%f:%f%c", &parameters.clampMin, &parameters.clampMax, &trailing) == 2 &&
+                parameters.clampMin <= parameters.clampMax) {
+                options->kernelConfig.epilogue.activation = GemmActivation::Clamp;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--requantize") == 0) {
+            if (strcmp(value, "none") == 0) {
+                options->kernelConfig.epilogue.outputType = GemmOutputType::Accumulator;
+            } else if (strcmp(value, "u8") == 0) {
+                options->kernelConfig.epilogue.outputType = GemmOutputType::Uint8;
+            } else if (strcmp(value, "s8") == 0) {
+                options->kernelConfig.epilogue.outputType = GemmOutputType::Sint8;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--zero-points") == 0) {
+            if (strcmp(value, "none") == 0) {
+                options->kernelConfig.epilogue.zeroPoints = GemmZeroPoints::None;
+            } else if (strcmp(value, "tensor") == 0) {
+                options->kernelConfig.epilogue.zeroPoints = GemmZeroPoints::PerTensor;
+            } else if (strcmp(value, "column") == 0) {
+                options->kernelConfig.epilogue.zeroPoints = GemmZeroPoints::PerColumn;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--pack") == 0) {
+            if (strcmp(value, "none") == 0) {
+                options->packing = BenchmarkPacking::None;
+            } else if (strcmp(value, "host") == 0) {
+                options->packing = BenchmarkPacking::Host;
+            } else if (strcmp(value, "gpu") == 0) {
+                options->packing = BenchmarkPacking::Gpu;
+            } else {
+                return false;
+            }
+            options->kernelConfig.packedOperands = options->packing != BenchmarkPacking::None;
+        } else if (strcmp(argument, "--layout") == 0) {
+            // One letter per operand, A, B then C, as in the kernel names.
+            GemmLayout* layouts[] = {
+                &options->kernelConfig.layoutA, &options->kernelConfig.layoutB, &options->kernelConfig.layoutC,
+            };
+            if (strlen(value) != 3) {
+                return false;
+            }
+            for (int i = 0; i < 3; ++i) {
+                if (value[i] == 'c') {
+                    *layouts[i] = GemmLayout::ColumnMajor;
+                } else if (value[i] == 'r') {
+                    *layouts[i] = GemmLayout::RowMajor;
+                } else {
+                    return false;
+                }
+            }
+        } else if (strcmp(argument, "--int4-weights") == 0) {
+            uint32_t& groupSize = options->kernelConfig.int4GroupSize;
+            if (!ParseUnsigned(value, &groupSize) || groupSize % 8 != 0) {
+                return false;
+            }
+        } else if (strcmp(argument, "--scale") == 0) {
+            options->epilogueParameters.scale = static_cast<float>(atof(value));
+        } else if (strcmp(argument, "--type") == 0) {
+            for (const std::string& item : SplitList(value)) {
+                options->types.push_back(item);
+            }
+        } else if (strcmp(argument, "--kernel") == 0) {
+            if (strcmp(value, "shared") == 0) {
+                options->kernelConfig.stageInShared = true;
+            } else if (strcmp(value, "direct") == 0) {
+                options->kernelConfig.stageInShared = false;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--backend") == 0) {
+            if (strcmp(value, "gpu") == 0) {
+                options->backend = BenchmarkBackend::Gpu;
+            } else if (strcmp(value, "cpu") == 0) {
+                options->backend = BenchmarkBackend::Cpu;
+            } else if (strcmp(value, "all") == 0) {
+                options->backend = BenchmarkBackend::All;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--cpu-threads") == 0) {
+            if (!ParseUnsigned(value, &options->cpuThreads)) {
+                return false;
+            }
+        } else if (strcmp(argument, "--cpu-isa") == 0) {
+            // Only narrower instruction sets than the detected one can be selected.
+            CpuGemmIsa detected = DetectCpuGemmIsa();
+            if (strcmp(value, "scalar") == 0) {
+                options->cpuIsa = CpuGemmIsa::Scalar;
+            } else if (strcmp(value, "avx2") == 0 && detected != CpuGemmIsa::Scalar) {
+                options->cpuIsa = CpuGemmIsa::Avx2;
+            } else if (strcmp(value, "avx512vnni") == 0 && detected == CpuGemmIsa::Avx512Vnni) {
+                options->cpuIsa = CpuGemmIsa::Avx512Vnni;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argument, "--warmup") == 0) {
+            if (!ParseUnsigned(value, &options->warmupIterations)) {
+                return false;
+            }
+        } else if (strcmp(argument, "--repetitions") == 0) {
+            if (!ParseUnsigned(value, &options->repetitions) || options->repetitions == 0) {
+                return false;
+            }
+        } else if (strcmp(argument, "--verify-trials") == 0) {
+            if (!ParseUnsigned(value, &options->verificationTrials)) {
+                return false;
+            }
+        } else if (strcmp(argument, "--seed") == 0) {
+            if (!ParseUnsigned(value, &options->seed)) {
+                return false;
+            }
+        } else if (strcmp(argument, "--pipeline-cache") == 0) {
+            options->pipelineCachePath = strcmp(value, "none") == 0 ? "" : value;
+        } else if (strcmp(argument, "--autotune") == 0) {
+            options->autotunePath = value;
+        } else if (strcmp(argument, "--json") == 0) {
+            options->jsonPath = value;
+        } else if (strcmp(argument, "--csv") == 0) {
+            options->csvPath = value;
+        } else if (strcmp(argument, "--baseline") == 0) {
+            options->baselinePath = value;
+        } else if (strcmp(argument, "--threshold") == 0) {
+            options->regressionThreshold = atof(value) / 100.0;
+        } else {
+            return false;
+        }
+    }
+    // Grouped and split-K kernels use descriptors for the group table and the partial results, as do zero
+    // points for the row and column sums and packed weights for their scales. The epilogue has to see the whole
+    // of K, grouped results are only verified with Freivalds' algorithm, and weights are unpacked while staged.
+    // Packed operands have a layout of their own, which neither the zero point sums nor 4-bit weights read, and
+    // which is only built from column-major operands, as are 4-bit weights. Grouped runs are not batched.
+    const GemmKernelConfig& kernelConfig = options->kernelConfig;
+    bool hasEpilogue = !IsEpilogueEmpty(kernelConfig.epilogue);
+    bool batched = std::any_of(options->batchSizes.begin(), options->batchSizes.end(),
+        [](uint32_t batchSize) { return batchSize > 1; });
+    return !(kernelConfig.grouped && batched) &&
+        !(kernelConfig.deviceAddress && (kernelConfig.grouped || kernelConfig.splitK)) &&
+        !(kernelConfig.grouped && kernelConfig.splitK) &&
+        !(hasEpilogue && (kernelConfig.grouped || kernelConfig.splitK)) &&
+        !(kernelConfig.epilogue.zeroPoints != GemmZeroPoints::None && kernelConfig.deviceAddress) &&
+        !(kernelConfig.int4GroupSize != 0 &&
+            (!kernelConfig.stageInShared || kernelConfig.grouped || kernelConfig.deviceAddress)) &&
+        !(kernelConfig.packedOperands && (kernelConfig.grouped || kernelConfig.int4GroupSize != 0 ||
+            kernelConfig.epilogue.zeroPoints != GemmZeroPoints::None)) &&
+        !(options->packing == BenchmarkPacking::Gpu && kernelConfig.deviceAddress) &&
+        !(kernelConfig.packedOperands &&
+            (kernelConfig.layoutA != GemmLayout::ColumnMajor || kernelConfig.layoutB != GemmLayout::ColumnMajor)) &&
+        !(kernelConfig.int4GroupSize != 0 && kernelConfig.layoutB != GemmLayout::ColumnMajor);
+}
+
+void PrintBenchmarkUsage() {
+    printf(
+        "Usage: VulkanTest [options]\n"
+        "  --shape MxNxK[,MxNxK...]  problem shapes (default: one cooperative matrix tile)\n"
+        "  --type T[,T...]           cooperative matrix types by prefix, e.g. u8 or u8_u8_u32_u32\n"
+        "  --sweep                   benchmark every advertised tile size (default shape 2048x2048x2048)\n"
+        "  --batch N[,N...]          run every shape as a batched GEMM of each size (default 1)\n"
+        "  --groups N                run every shape as a grouped GEMM of N groups with random M (not with --batch)\n"
+        "  --split-k auto|N          split K into N partitions reduced by a second pass, or pick N per shape\n"
+        "  --kernel direct|shared    load A/B straight from the buffers or stage them in shared memory\n"
+        "  --pack none|host|gpu      load A/B as contiguous tiles, packed once per shape on the host or the GPU\n"
+        "  --layout XYZ              c (column major) or r (row major) for A, B and C, e.g. rcc (default ccc)\n"
+        "  --device-address          pass A/B/C as buffer device addresses, not descriptors (no --groups or --split-k)\n"
+        "  --int4-weights G          pack B to 4-bit weights with a scale per G elements (f16, --kernel shared)\n"
+        "  --zero-points MODE        none, tensor or column: subtract random zero points of A and B in the epilogue\n"
+        "  --bias                    add a random per-column bias in the kernel epilogue (integer types only)\n"
+        "  --activation A            none, relu or clamp:MIN:MAX in the kernel epilogue (integer types only)\n"
+        "  --requantize none|u8|s8   scale, round and saturate the result to 8 bits in the kernel epilogue\n"
+        "  --scale F                 requantization scale (default 1)\n"
+        "  --backend gpu|cpu|all     where to run; the CPU also runs if the GPU has no selected type (default gpu)\n"
+        "  --cpu-threads N           CPU backend threads (default: all hardware threads)\n"
+        "  --cpu-isa ISA             scalar, avx2 or avx512vnni CPU microkernels (default: widest supported)\n"
+        "  --warmup N                unmeasured dispatches before measuring (default 5)\n"
+        "  --repetitions N           measured dispatches (default 50)\n"
+        "  --print-result            print small result matrices\n"
+        "  --rerecord                record the round-trip command buffer every repetition instead of replaying it\n"
+        "  --verify-trials N         Freivalds verification trials per result, 0 to skip (default 2)\n"
+        "  --seed N                  seed for the random inputs (default 1)\n"
+        "  --pipeline-cache PATH     pipeline cache file, or none (default pipeline_cache.bin)\n"
+        "  --autotune PATH           run kernels tuned per shape class, searched once and kept in a device database\n"
+        "  --retune                  search again even where the autotuning database has a tuned kernel\n"
+        "  --json PATH               write a JSON report\n"
+        "  --csv PATH                write a CSV report\n"
+        "  --baseline PATH           compare with a JSON report from an earlier run\n"
+        "  --threshold PERCENT       median slowdown reported as a regression (default 5)\n");
+}
+
+bool MatchesTypeFilter(const BenchmarkOptions& options, const std::string& typeName) {
+    if (options.types.empty()) {
+        return true;
+    }
+    for (const std::string& type : options.types) {
+        if (typeName.compare(0, type.size(), type) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<GemmShape> GetBenchmarkShapes(
+    const BenchmarkOptions& options, const VkCooperativeMatrixPropertiesKHR& property) {
+    std::vector<GemmShape> shapes = options.shapes;
+    if (shapes.empty()) {
+        shapes.push_back(options.sweep ? kDefaultSweepShape :
+            GemmShape{ property.MSize, property.NSize, property.KSize });
+    }
+    if (options.batchSizes.empty()) {
+        return shapes;
+    }
+    std::vector<GemmShape> batchedShapes;
+    for (const GemmShape& shape : shapes) {
+        for (uint32_t batchSize : options.batchSizes) {
+            batchedShapes.push_back(shape);
+            batchedShapes.back().batch = batchSize;
+        }
+    }
+    return batchedShapes;
+}
+
+std::string GetShapeName(const GemmShape& shape) {
+    std::string name = std::to_string(shape.m) + "x" + std::to_string(shape.n) + "x" + std::to_string(shape.k);
+    if (shape.batch > 1) {
+        name += "b" + std::to_string(shape.batch);
+    }
+    return name;
+}
+
+BenchmarkStatistics ComputeStatistics(std::vector<double> samples) {
+    BenchmarkStatistics statistics;
+    if (samples.empty()) {
+        return statistics;
+    }
+    std::sort(samples.begin(), samples.end());
+    statistics.min = samples.front();
+    statistics.median = Percentile(samples, 0.5);
+    statistics.p90 = Percentile(samples, 0.9);
+    statistics.p99 = Percentile(samples, 0.99);
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    statistics.mean = sum / static_cast<double>(samples.size());
+    return statistics;
+}
+
+double GetOperationCount(const GemmShape& shape) {
+    return 2.0 * shape.m * shape.n * shape.k * shape.batch;
+}
+
+double GetTeraOperationsPerSecond(const BenchmarkResult& result, double nanoseconds) {
+    return nanoseconds > 0.0 ? GetOperationCount(result.shape) / nanoseconds / 1e3 : 0.0;
+}
+
+double GetGigabytesPerSecond(const BenchmarkResult& result, double nanoseconds) {
+    return nanoseconds > 0.0 ? static_cast<double>(result.kernelBytes) / nanoseconds : 0.0;
+}
+
+void PrintBenchmarkTable(const std::vector<BenchmarkResult>& results) {
+    printf("%-56s %12s %12s %12s %12s %10s %10s %14s %9s %s\n",
+        "benchmark", "min ns", "median ns", "p90 ns", "p99 ns", "TOPS", "GB/s", "round trip ns", "overlap %",
+        "verified");
+    for (const BenchmarkResult& result : results) {
+        printf("%-56s %12.0f %12.0f %12.0f %12.0f %10.3f %10.2f %14.0f %9.1f %s%s\n",
+            result.name.c_str(), result.kernelNanoseconds.min, result.kernelNanoseconds.median,
+            result.kernelNanoseconds.p90, result.kernelNanoseconds.p99,
+            GetTeraOperationsPerSecond(result, result.kernelNanoseconds.median),
+            GetGigabytesPerSecond(result, result.kernelNanoseconds.median), result.roundTripNanoseconds.median,
+            result.streamingOverlap * 100.0, result.verified ? "yes" : "NO", result.gpuTimestamps ? "" : " (host timer)");
+    }
+    printf("\n");
+}
+
+void PrintBestConfigurations(const std::vector<BenchmarkResult>& results) {
+    std::map<std::string, const BenchmarkResult*> best;
+    for (const BenchmarkResult& result : results) {
+        if (!result.verified) {
+            continue;
+        }
+        const BenchmarkResult*& current = best[result.type];
+        if (current == nullptr ||
+            GetTeraOperationsPerSecond(result, result.kernelNanoseconds.median) >
+            GetTeraOperationsPerSecond(*current, current->kernelNanoseconds.median)) {
+            current = &result;
+        }
+    }
+    printf("%-20s %-12s %-20s %-8s %10s\n", "type", "tile", "shape", "kernel", "TOPS");
+    for (const auto& entry : best) {
+        const BenchmarkResult& result = *entry.second;
+        printf("%-20s %-12s %-20s %-8s %10.3f\n", result.type.c_str(), result.tile.c_str(),
+            GetShapeName(result.shape).c_str(),
+            result.kernel.c_str(), GetTeraOperationsPerSecond(result, result.kernelNanoseconds.median));
+    }
+    printf("\n");
+}
+
+JsonValue MakeDeviceJson(const VulkanRuntime* vulkanRuntime) {
+    JsonValue json = JsonValue::MakeObject();
+    if (vulkanRuntime == nullptr) {
+        json["name"] = "cpu";
+        json["cpuIsa"] = GetCpuGemmIsaName(DetectCpuGemmIsa());
+        return json;
+    }
+    const VkPhysicalDeviceProperties& properties = vulkanRuntime->GetPhysicalDeviceProperties();
+    json["name"] = properties.deviceName;
+    json["vendorID"] = properties.vendorID;
+    json["deviceID"] = properties.deviceID;
+    json["driverVersion"] = properties.driverVersion;
+    json["apiVersion"] = FormatApiVersion(properties.apiVersion);
+    json["info"] = vulkanRuntime->GetDeviceInfo();
+    return json;
+}
+
+bool WriteJsonReport(
+    const std::string& path, const VulkanRuntime* vulkanRuntime, const std::vector<BenchmarkResult>& results) {
+    JsonValue report = JsonValue::MakeObject();
+    report["device"] = MakeDeviceJson(vulkanRuntime);
+    JsonValue& resultsJson = report["results"] = JsonValue::MakeArray();
+    for (const BenchmarkResult& result : results) {
+        JsonValue json = JsonValue::MakeObject();
+        json["name"] = result.name;
+        json["type"] = result.type;
+        json["tile"] = result.tile;
+        json["kernel"] = result.kernel;
+        json["m"] = result.shape.m;
+        json["n"] = result.shape.n;
+        json["k"] = result.shape.k;
+        json["batch"] = result.shape.batch;
+        json["repetitions"] = result.repetitions;
+        json["gpuTimestamps"] = result.gpuTimestamps;
+        json["kernelNanoseconds"] = MakeStatisticsJson(result.kernelNanoseconds);
+        json["medianTops"] = GetTeraOperationsPerSecond(result, result.kernelNanoseconds.median);
+        json["medianGigabytesPerSecond"] = GetGigabytesPerSecond(result, result.kernelNanoseconds.median);
+        json["setupNanoseconds"] = result.setupNanoseconds;
+        json["uploadNanoseconds"] = result.uploadNanoseconds;
+        json["packNanoseconds"] = result.packNanoseconds;
+        json["readbackNanoseconds"] = result.readbackNanoseconds;
+        json["roundTripNanoseconds"] = MakeStatisticsJson(result.roundTripNanoseconds);
+        json["streamingNanoseconds"] = result.streamingNanoseconds;
+        json["streamingOverlap"] = result.streamingOverlap;
+        json["verified"] = result.verified;
+        resultsJson.Append(std::move(json));
+    }
+    return WriteJsonFile(path, report);
+}
+
+bool WriteCsvReport(
+    const std::string& path, const VulkanRuntime* vulkanRuntime, const std::vector<BenchmarkResult>& results) {
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream.is_open()) {
+        return false;
+    }
+    VkPhysicalDeviceProperties properties = {};
+    if (vulkanRuntime != nullptr) {
+        properties = vulkanRuntime->GetPhysicalDeviceProperties();
+    } else {
+        strcpy(properties.deviceName, "cpu");
+    }
+    stream << "device,vendor_id,device_id,driver_version,name,type,tile,kernel,m,n,k,batch,repetitions,"
+        << "min_ns,median_ns,p90_ns,p99_ns,mean_ns,median_tops,median_gbps,setup_ns,upload_ns,pack_ns,readback_ns,"
+        << "round_trip_median_ns,streaming_ns,streaming_overlap,verified\n";
+    for (const BenchmarkResult& result : results) {
+        stream << "\"" << properties.deviceName << "\"," << properties.vendorID << "," << properties.deviceID
+            << "," << properties.driverVersion << "," << result.name << "," << result.type << "," << result.tile << ","
+            << result.kernel << "," << result.shape.m << "," << result.shape.n << "," << result.shape.k << ","
+            << result.shape.batch << "," << result.repetitions << "," << result.kernelNanoseconds.min << ","
+            << result.kernelNanoseconds.median << "," << result.kernelNanoseconds.p90 << ","
+            << result.kernelNanoseconds.p99 << "," << result.kernelNanoseconds.mean << ","
+            << GetTeraOperationsPerSecond(result, result.kernelNanoseconds.median) << ","
+            << GetGigabytesPerSecond(result, result.kernelNanoseconds.median) << ","
+            << result.setupNanoseconds << "," << result.uploadNanoseconds << "," << result.packNanoseconds << ","
+            << result.readbackNanoseconds << ","
+            << result.roundTripNanoseconds.median << "," << result.streamingNanoseconds << ","
+            << result.streamingOverlap << ","
+            << (result.verified ? "true" : "false") << "\n";
+    }
+    return stream.good();
+}
+
+int CompareWithBaseline(
+    const std::string& path, const std::vector<BenchmarkResult>& results, double regressionThreshold) {
+    JsonValue baseline;
+    std::string error;
+    if (!ReadJsonFile(path, &baseline, &error)) {
+        std::cerr << "Failed to read baseline: " << error << std::endl;
+        return -1;
+    }
+    const JsonValue* baselineDevice = baseline.Find("device");
+    if (baselineDevice != nullptr) {
+        printf("Baseline: %s, driver version %.0f\n",
+            baselineDevice->GetString("name", "unknown device").c_str(),
+            baselineDevice->GetNumber("driverVersion", 0.0));
+    }
+
+    std::map<std::string, double> baselineMedians;
+    const JsonValue* baselineResults = baseline.Find("results");
+    if (baselineResults != nullptr) {
+        for (const JsonValue& result : baselineResults->AsArray()) {
+            const JsonValue* kernelNanoseconds = result.Find("kernelNanoseconds");
+            if (kernelNanoseconds != nullptr) {
+                baselineMedians[result.GetString("name", "")] = kernelNanoseconds->GetNumber("median", 0.0);
+            }
+        }
+    }
+
+    int regressionCount = 0;
+    for (const BenchmarkResult& result : results) {
+        auto baselineMedian = baselineMedians.find(result.name);
+        if (baselineMedian == baselineMedians.end() || baselineMedian->second <= 0.0) {
+            printf("  %-56s no baseline\n", result.name.c_str());
+            continue;
+        }
+        double change = result.kernelNanoseconds.median / baselineMedian->second - 1.0;
+        const char* verdict = "ok";
+        if (change > regressionThreshold) {
+            verdict = "REGRESSION";
+            ++regressionCount;
+        } else if (change < -regressionThreshold) {
+            verdict = "improved";
+        }
+        printf("  %-56s %12.0f -> %12.0f ns (%+6.1f%%) %s\n", result.name.c_str(), baselineMedian->second,
+            result.kernelNanoseconds.median, change * 100.0, verdict);
+    }
+    printf("\n");
+    return regressionCount;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "CpuGemm.h"
+#include "GemmKernel.h"
+#include "Json.h"
+
+enum class BenchmarkBackend {
+    Gpu,
+    Cpu,
+    // GPU and CPU, for a CPU-vs-GPU baseline.
+    All,
+};
+
+// Where A and B are rearranged for kernels with GemmKernelConfig::packedOperands.
+enum class BenchmarkPacking {
+    None,
+    // PackOperandTiles() on the host before the upload.
+    Host,
+    // GemmKernel::RecordPackOperands() on the uploaded operands.
+    Gpu,
+};
+
+struct BenchmarkOptions {
+    // The CPU backend also runs when the GPU supports none of the selected types.
+    BenchmarkBackend backend = BenchmarkBackend::Gpu;
+    // 0 uses every hardware thread.
+    uint32_t cpuThreads = 0;
+    CpuGemmIsa cpuIsa = DetectCpuGemmIsa();
+
+    // Empty means a single cooperative matrix tile of each selected type, or kDefaultSweepShape when sweeping.
+    std::vector<GemmShape> shapes;
+    // Prefixes of GemmKernel::GetShaderVariantName(), e.g. "u8" or "u8_u8_u32_u32". Empty selects every type.
+    std::vector<std::string> types;
+    // Benchmark every advertised tile size of each type instead of only the first one.
+    bool sweep = false;
+    // Every shape runs once per batch size as a strided batched GEMM; empty runs every shape unbatched.
+    std::vector<uint32_t> batchSizes;
+    // Runs every shape as a grouped GEMM of this many groups instead, each with a random M that averages the
+    // shape's M, sharing N and K. 0 disables grouped runs.
+    uint32_t groupCount = 0;
+    // K partitions of every dispatch: 1 disables split-K, 0 picks them per shape with
+    // GemmKernel::GetSplitKFactor().
+    uint32_t splitK = 1;
+    // Packs A and B once per shape, before the measured dispatches, as static weights would be.
+    BenchmarkPacking packing = BenchmarkPacking::None;
+    GemmKernelConfig kernelConfig;
+    // Scale and clamp range of kernelConfig.epilogue. The CPU backend runs without the epilogue.
+    GemmEpilogueParameters epilogueParameters;
+    uint32_t warmupIterations = 5;
+    uint32_t repetitions = 50;
+    bool printResult = false;
+    // Record the upload, dispatch and readback round trip once and replay it, instead of recording it for
+    // every repetition.
+    bool replayCommandBuffers = true;
+    // Freivalds trials run on every result; 0 disables verification.
+    uint32_t verificationTrials = 2;
+    // Also measure upload, dispatch and readback round trips and streamed tiles, not only the kernel.
+    bool measureTransfers = true;
+    // Seeds the random inputs and verification vectors.
+    uint32_t seed = 1;
+
+    // Loaded before and saved after the GPU benchmarks; empty disables the on-disk pipeline cache.
+    std::string pipelineCachePath = "pipeline_cache.bin";
+    // Database of tuned kernel parameters, see AutotuneDatabase. When set, every GPU benchmark runs the kernel
+    // tuned for its shape class, searched first unless the database already has it; empty disables tuning.
+    std::string autotunePath;
+    // Search again even for shape classes the database already has.
+    bool retune = false;
+    std::string jsonPath;
+    std::string csvPath;
+    std::string baselinePath;
+    // Relative slowdown of the median kernel time that counts as a regression.
+    double regressionThreshold = 0.05;
+};
+
+constexpr GemmShape kDefaultSweepShape = { 2048, 2048, 2048 };
+
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions* options);
+void PrintBenchmarkUsage();
+bool MatchesTypeFilter(const BenchmarkOptions& options, const std::string& typeName);
+// options.shapes, or the default shape for the tile size of property, expanded by options.batchSizes.
+std::vector<GemmShape> GetBenchmarkShapes(
+    const BenchmarkOptions& options, const VkCooperativeMatrixPropertiesKHR& property);
+// "MxNxK", followed by "bB" for batches of more than one entry.
+std::string GetShapeName(const GemmShape& shape);
+
+struct BenchmarkStatistics {
+    double min = 0.0;
+    double median = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double mean = 0.0;
+};
+
+BenchmarkStatistics ComputeStatistics(std::vector<double> samples);
+
+struct BenchmarkResult {
+    std::string name;
+    std::string type;
+    // Cooperative matrix tile, "MxNxK".
+    std::string tile;
+    std::string kernel;
+    GemmShape shape;
+    uint32_t repetitions = 0;
+    // Minimum number of bytes the kernel has to move: A and B once, the result once, for every batch entry.
+    uint64_t kernelBytes = 0;
+    // False when the device has no timestamp support and kernel times are host wall-clock times.
+    bool gpuTimestamps = true;
+    BenchmarkStatistics kernelNanoseconds;
+    // Host time to create and allocate the benchmark buffers.
+    double setupNanoseconds = 0.0;
+    // Host time to stream the inputs through the staging ring until the copies completed.
+    double uploadNanoseconds = 0.0;
+    // Time to pack A and B once: host time, or GPU time with GPU packing. 0 without packed operands.
+    double packNanoseconds = 0.0;
+    double readbackNanoseconds = 0.0;
+    // Host time from submitting one upload, dispatch and readback sequence until it completed, including
+    // recording unless the sequence is replayed. Not measured for the CPU backend.
+    BenchmarkStatistics roundTripNanoseconds;
+    // Host time per tile when tiles are streamed through two buffer sets, uploads and readbacks running on the
+    // transfer queue while the previous tile computes.
+    double streamingNanoseconds = 0.0;
+    // 1 - streamed time / time with every tile waited for before the next is submitted; 0 means no overlap.
+    double streamingOverlap = 0.0;
+    bool verified = false;
+    // The kernel cannot run the shape, so nothing was measured. Skipped results are not reported.
+    bool skipped = false;
+};
+
+// Counts every batch entry.
+double GetOperationCount(const GemmShape& shape);
+double GetTeraOperationsPerSecond(const BenchmarkResult& result, double nanoseconds);
+double GetGigabytesPerSecond(const BenchmarkResult& result, double nanoseconds);
+
+void PrintBenchmarkTable(const std::vector<BenchmarkResult>& results);
+// Prints the fastest verified tile of every type by median throughput.
+void PrintBestConfigurations(const std::vector<BenchmarkResult>& results);
+
+// vulkanRuntime is null when only the CPU backend ran.
+JsonValue MakeDeviceJson(const VulkanRuntime* vulkanRuntime);
+bool WriteJsonReport(
+    const std::string& path, const VulkanRuntime* vulkanRuntime, const std::vector<BenchmarkResult>& results);
+bool WriteCsvReport(
+    const std::string& path, const VulkanRuntime* vulkanRuntime, const std::vector<BenchmarkResult>& results);
+
+// Compares median kernel times with a report previously written by WriteJsonReport().
+// Returns the number of regressions, or -1 if the baseline cannot be read.
+int CompareWithBaseline(
+    const std::string& path, const std::vector<BenchmarkResult>& results, double regressionThreshold);
+
+#endif
@@ -0,0 +1,523 @@
+#include "CpuGemm.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_GEMM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define CPU_GEMM_X86 0
+#endif
+
+// MSVC compiles intrinsics for any instruction set without extra flags; GCC and Clang need the target
+// enabled per function so that the rest of the binary still runs on older CPUs.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CPU_GEMM_TARGET(features)
+#else
+#define CPU_GEMM_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace {
+    // Block sizes: every ParallelFor() task owns a BLOCK_M x BLOCK_N block of C and walks K in BLOCK_K slices,
+    // so that the packed slices of A and B (64KB each for 8-bit inputs) stay in L2.
+    constexpr uint32_t kBlockM = 128;
+    constexpr uint32_t kBlockN = 128;
+    constexpr uint32_t kBlockK = 256;
+
+    // Packed 8-bit panels hold pairs of consecutive K values as int16, the operand layout of vpmaddwd and
+    // vpdpwssd. Each microkernel computes an MR x NR tile of C, column major with a leading dimension of MR.
+    using IntegerMicrokernel = void (*)(const int16_t* a, const int16_t* b, uint32_t kPairs, uint32_t* tile);
+    using FloatMicrokernel = void (*)(const float* a, const float* b, uint32_t k, float* tile);
+
+    struct Microkernels {
+        uint32_t mr;
+        uint32_t nr;
+        IntegerMicrokernel integerMicrokernel;
+        FloatMicrokernel floatMicrokernel;
+    };
+
+    constexpr uint32_t kScalarMR = 8;
+    constexpr uint32_t kScalarNR = 4;
+
+    void IntegerMicrokernelScalar(const int16_t* a, const int16_t* b, uint32_t kPairs, uint32_t* tile) {
+        uint32_t accumulators[kScalarMR * kScalarNR] = {};
+        for (uint32_t kp = 0; kp < kPairs; ++kp) {
+            const int16_t* aPairs = a + kp * kScalarMR * 2;
+            const int16_t* bPairs = b + kp * kScalarNR * 2;
+            for (uint32_t c = 0; c < kScalarNR; ++c) {
+                for (uint32_t r = 0; r < kScalarMR; ++r) {
+                    int32_t sum = aPairs[r * 2] * bPairs[c * 2] + aPairs[r * 2 + 1] * bPairs[c * 2 + 1];
+                    accumulators[c * kScalarMR + r] += static_cast<uint32_t>(sum);
+                }
+            }
+        }
+        memcpy(tile, accumulators, sizeof(accumulators));
+    }
+
+    void FloatMicrokernelScalar(const float* a, const float* b, uint32_t k, float* tile) {
+        float accumulators[kScalarMR * kScalarNR] = {};
+        for (uint32_t kk = 0; kk < k; ++kk) {
+            for (uint32_t c = 0; c < kScalarNR; ++c) {
+                for (uint32_t r = 0; r < kScalarMR; ++r) {
+                    accumulators[c * kScalarMR + r] += a[kk * kScalarMR + r] * b[kk * kScalarNR + c];
+                }
+            }
+        }
+        memcpy(tile, accumulators, sizeof(accumulators));
+    }
+
+#if CPU_GEMM_X86
+    constexpr uint32_t kAvx2MR = 16;
+    constexpr uint32_t kAvx2NR = 4;
+
+    CPU_GEMM_TARGET("avx2")
+    void IntegerMicrokernelAvx2(const int16_t* a, const int16_t* b, uint32_t kPairs, uint32_t* tile) {
+        __m256i accumulators[kAvx2NR][2];
+        for (uint32_t c = 0; c < kAvx2NR; ++c) {
+            accumulators[c][0] = _mm256_setzero_si256();
+            accumulators[c][1] = _mm256_setzero_si256();
+        }
+        for (uint32_t kp = 0; kp < kPairs; ++kp) {
+            __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + kp * kAvx2MR * 2));
+            __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + kp * kAvx2MR * 2 + 16));
+            for (uint32_t c = 0; c < kAvx2NR; ++c) {
+                int32_t bPair;
+                memcpy(&bPair, b + (kp * kAvx2NR + c) * 2, sizeof(bPair));
+                __m256i bValue = _mm256_set1_epi32(bPair);
+                accumulators[c][0] = _mm256_add_epi32(accumulators[c][0], _mm256_madd_epi16(a0, bValue));
+                accumulators[c][1] = _mm256_add_epi32(accumulators[c][1], _mm256_madd_epi16(a1, bValue));
+            }
+        }
+        for (uint32_t c = 0; c < kAvx2NR; ++c) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(tile + c * kAvx2MR), accumulators[c][0]);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(tile + c * kAvx2MR + 8), accumulators[c][1]);
+        }
+    }
+
+    CPU_GEMM_TARGET("avx2,fma")
+    void FloatMicrokernelAvx2(const float* a, const float* b, uint32_t k, float* tile) {
+        __m256 accumulators[kAvx2NR][2];
+        for (uint32_t c = 0; c < kAvx2NR; ++c) {
+            accumulators[c][0] = _mm256_setzero_ps();
+            accumulators[c][1] = _mm256_setzero_ps();
+        }
+        for (uint32_t kk = 0; kk < k; ++kk) {
+            __m256 a0 = _mm256_loadu_ps(a + kk * kAvx2MR);
+            __m256 a1 = _mm256_loadu_ps(a + kk * kAvx2MR + 8);
+            for (uint32_t c = 0; c < kAvx2NR; ++c) {
+                __m256 bValue = _mm256_broadcast_ss(b + kk * kAvx2NR + c);
+                accumulators[c][0] = _mm256_fmadd_ps(a0, bValue, accumulators[c][0]);
+                accumulators[c][1] = _mm256_fmadd_ps(a1, bValue, accumulators[c][1]);
+            }
+        }
+        for (uint32_t c = 0; c < kAvx2NR; ++c) {
+            _mm256_storeu_ps(tile + c * kAvx2MR, accumulators[c][0]);
+            _mm256_storeu_ps(tile + c * kAvx2MR + 8, accumulators[c][1]);
+        }
+    }
+
+    constexpr uint32_t kAvx512MR = 32;
+    constexpr uint32_t kAvx512NR = 8;
+
+    CPU_GEMM_TARGET("avx512f,avx512bw,avx512vnni")
+    void IntegerMicrokernelAvx512Vnni(const int16_t* a, const int16_t* b, uint32_t kPairs, uint32_t* tile) {
+        __m512i accumulators[kAvx512NR][2];
+        for (uint32_t c = 0; c < kAvx512NR; ++c) {
+            accumulators[c][0] = _mm512_setzero_si512();
+            accumulators[c][1] = _mm512_setzero_si512();
+        }
+        for (uint32_t kp = 0; kp < kPairs; ++kp) {
+            __m512i a0 = _mm512_loadu_si512(a + kp * kAvx512MR * 2);
+            __m512i a1 = _mm512_loadu_si512(a + kp * kAvx512MR * 2 + 32);
+            for (uint32_t c = 0; c < kAvx512NR; ++c) {
+                int32_t bPair;
+                memcpy(&bPair, b + (kp * kAvx512NR + c) * 2, sizeof(bPair));
+                __m512i bValue = _mm512_set1_epi32(bPair);
+                accumulators[c][0] = _mm512_dpwssd_epi32(accumulators[c][0], a0, bValue);
+                accumulators[c][1] = _mm512_dpwssd_epi32(accumulators[c][1], a1, bValue);
+            }
+        }
+        for (uint32_t c = 0; c < kAvx512NR; ++c) {
+            _mm512_storeu_si512(tile + c * kAvx512MR, accumulators[c][0]);
+            _mm512_storeu_si512(tile + c * kAvx512MR + 16, accumulators[c][1]);
+        }
+    }
+
+    CPU_GEMM_TARGET("avx512f")
+    void FloatMicrokernelAvx512(const float* a, const float* b, uint32_t k, float* tile) {
+        __m512 accumulators[kAvx512NR][2];
+        for (uint32_t c = 0; c < kAvx512NR; ++c) {
+            accumulators[c][0] = _mm512_setzero_ps();
+            accumulators[c][1] = _mm512_setzero_ps();
+        }
+        for (uint32_t kk = 0; kk < k; ++kk) {
+            __m512 a0 = _mm512_loadu_ps(a + kk * kAvx512MR);
+            __m512 a1 = _mm512_loadu_ps(a + kk * kAvx512MR + 16);
+            for (uint32_t c = 0; c < kAvx512NR; ++c) {
+                __m512 bValue = _mm512_set1_ps(b[kk * kAvx512NR + c]);
+                accumulators[c][0] = _mm512_fmadd_ps(a0, bValue, accumulators[c][0]);
+                accumulators[c][1] = _mm512_fmadd_ps(a1, bValue, accumulators[c][1]);
+            }
+        }
+        for (uint32_t c = 0; c < kAvx512NR; ++c) {
+            _mm512_storeu_ps(tile + c * kAvx512MR, accumulators[c][0]);
+            _mm512_storeu_ps(tile + c * kAvx512MR + 16, accumulators[c][1]);
+        }
+    }
+#endif
+
+    Microkernels GetMicrokernels(CpuGemmIsa isa) {
+        switch (isa) {
+#if CPU_GEMM_X86
+            case CpuGemmIsa::Avx512Vnni:
+                return { kAvx512MR, kAvx512NR, IntegerMicrokernelAvx512Vnni, FloatMicrokernelAvx512 };
+            case CpuGemmIsa::Avx2:
+                return { kAvx2MR, kAvx2NR, IntegerMicrokernelAvx2, FloatMicrokernelAvx2 };
+#endif
+            default:
+                return { kScalarMR, kScalarNR, IntegerMicrokernelScalar, FloatMicrokernelScalar };
+        }
+    }
+
+    inline int16_t WidenToInt16(uint8_t value) {
+        return static_cast<int16_t>(value);
+    }
+
+    inline int16_t WidenToInt16(int8_t value) {
+        return static_cast<int16_t>(value);
+    }
+
+    // Packs rows [rowBegin, rowBegin + rows) x K values [kBegin, kBegin + kCount) of a column-major matrix
+    // into MR-row panels of K pairs; rows and K values past the end are zero.
+    template <typename T>
+    void PackIntegerA(
+        const T* a, uint32_t lda, uint32_t rowBegin, uint32_t rows, uint32_t kBegin, uint32_t kCount,
+        uint32_t mr, int16_t* packed) {
+        uint32_t kPairs = (kCount + 1) / 2;
+        for (uint32_t panel = 0; panel * mr < rows; ++panel) {
+            for (uint32_t kp = 0; kp < kPairs; ++kp) {
+                for (uint32_t half = 0; half < 2; ++half) {
+                    uint32_t k = kp * 2 + half;
+                    const T* column = a + static_cast<uint64_t>(kBegin + k) * lda + rowBegin + panel * mr;
+                    int16_t* destination = packed + ((panel * kPairs + kp) * mr) * 2 + half;
+                    for (uint32_t r = 0; r < mr; ++r) {
+                        bool inside = k < kCount && panel * mr + r < rows;
+                        destination[r * 2] = inside ? WidenToInt16(column[r]) : 0;
+                    }
+                }
+            }
+        }
+    }
+
+    // Packs K values [kBegin, kBegin + kCount) x columns [columnBegin, columnBegin + columns) of a column-major
+    // matrix into NR-column panels of K pairs.
+    template <typename T>
+    void PackIntegerB(
+        const T* b, uint32_t ldb, uint32_t columnBegin, uint32_t columns, uint32_t kBegin, uint32_t kCount,
+        uint32_t nr, int16_t* packed) {
+        uint32_t kPairs = (kCount + 1) / 2;
+        for (uint32_t panel = 0; panel * nr < columns; ++panel) {
+            for (uint32_t c = 0; c < nr; ++c) {
+                bool columnInside = panel * nr + c < columns;
+                const T* column = b + static_cast<uint64_t>(columnBegin + panel * nr + c) * ldb + kBegin;
+                for (uint32_t kp = 0; kp < kPairs; ++kp) {
+                    int16_t* destination = packed + ((panel * kPairs + kp) * nr + c) * 2;
+                    for (uint32_t half = 0; half < 2; ++half) {
+                        uint32_t k = kp * 2 + half;
+                        destination[half] = columnInside && k < kCount ? WidenToInt16(column[k]) : 0;
+                    }
+                }
+            }
+        }
+    }
+
+    void PackFloatA(
+        const uint16_t* a, uint32_t lda, uint32_t rowBegin, uint32_t rows, uint32_t kBegin, uint32_t kCount,
+        uint32_t mr, float* packed) {
+        for (uint32_t panel = 0; panel * mr < rows; ++panel) {
+            for (uint32_t k = 0; k < kCount; ++k) {
+                const uint16_t* column = a + static_cast<uint64_t>(kBegin + k) * lda + rowBegin + panel * mr;
+                float* destination = packed + (panel * kCount + k) * mr;
+                for (uint32_t r = 0; r < mr; ++r) {
+                    destination[r] = panel * mr + r < rows ? HalfToFloat(column[r]) : 0.0f;
+                }
+            }
+        }
+    }
+
+    void PackFloatB(
+        const uint16_t* b, uint32_t ldb, uint32_t columnBegin, uint32_t columns, uint32_t kBegin, uint32_t kCount,
+        uint32_t nr, float* packed) {
+        for (uint32_t panel = 0; panel * nr < columns; ++panel) {
+            for (uint32_t c = 0; c < nr; ++c) {
+                bool columnInside = panel * nr + c < columns;
+                const uint16_t* column = b + static_cast<uint64_t>(columnBegin + panel * nr + c) * ldb + kBegin;
+                for (uint32_t k = 0; k < kCount; ++k) {
+                    packed[(panel * kCount + k) * nr + c] = columnInside ? HalfToFloat(column[k]) : 0.0f;
+                }
+            }
+        }
+    }
+
+    uint32_t DivideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+
+    struct BlockRange {
+        uint32_t rowBegin;
+        uint32_t rows;
+        uint32_t columnBegin;
+        uint32_t columns;
+    };
+
+    BlockRange GetBlockRange(const GemmShape& shape, uint32_t blockIndex) {
+        uint32_t blocksM = DivideRoundingUp(shape.m, kBlockM);
+        BlockRange range;
+        range.rowBegin = (blockIndex % blocksM) * kBlockM;
+        range.columnBegin = (blockIndex / blocksM) * kBlockN;
+        range.rows = std::min(kBlockM, shape.m - range.rowBegin);
+        range.columns = std::min(kBlockN, shape.n - range.columnBegin);
+        return range;
+    }
+
+    // Accumulates one microkernel tile into the column-major block accumulator, dropping padded rows and columns.
+    template <typename T>
+    void AccumulateTile(
+        const T* tile, uint32_t mr, uint32_t nr, uint32_t row, uint32_t column, const BlockRange& range,
+        T* accumulator) {
+        uint32_t rows = std::min(mr, range.rows - row);
+        uint32_t columns = std::min(nr, range.columns - column);
+        for (uint32_t c = 0; c < columns; ++c) {
+            T* destination = accumulator + static_cast<uint64_t>(column + c) * range.rows + row;
+            for (uint32_t r = 0; r < rows; ++r) {
+                destination[r] += tile[c * mr + r];
+            }
+        }
+    }
+
+    template <typename AType, typename BType>
+    void RunIntegerBlock(
+        const Microkernels& microkernels, const GemmShape& shape, const AType* a, const BType* b, uint32_t* c,
+        uint32_t blockIndex) {
+        BlockRange range = GetBlockRange(shape, blockIndex);
+        uint32_t mr = microkernels.mr;
+        uint32_t nr = microkernels.nr;
+        uint32_t panelsM = DivideRoundingUp(range.rows, mr);
+        uint32_t panelsN = DivideRoundingUp(range.columns, nr);
+
+        thread_local std::vector<int16_t> packedA;
+        thread_local std::vector<int16_t> packedB;
+        thread_local std::vector<uint32_t> accumulator;
+        thread_local std::vector<uint32_t> tile;
+        packedA.resize(static_cast<size_t>(panelsM) * mr * kBlockK);
+        packedB.resize(static_cast<size_t>(panelsN) * nr * kBlockK);
+        accumulator.assign(static_cast<size_t>(range.rows) * range.columns, 0);
+        tile.resize(static_cast<size_t>(mr) * nr);
+
+        for (uint32_t kBegin = 0; kBegin < shape.k; kBegin += kBlockK) {
+            uint32_t kCount = std::min(kBlockK, shape.k - kBegin);
+            uint32_t kPairs = (kCount + 1) / 2;
+            PackIntegerA(a, shape.m, range.rowBegin, range.rows, kBegin, kCount, mr, packedA.data());
+            PackIntegerB(b, shape.k, range.columnBegin, range.columns, kBegin, kCount, nr, packedB.data());
+            for (uint32_t panelN = 0; panelN < panelsN; ++panelN) {
+                for (uint32_t panelM = 0; panelM < panelsM; ++panelM) {
+                    microkernels.integerMicrokernel(
+                        packedA.data() + static_cast<size_t>(panelM) * kPairs * mr * 2,
+                        packedB.data() + static_cast<size_t>(panelN) * kPairs * nr * 2, kPairs, tile.data());
+                    AccumulateTile(tile.data(), mr, nr, panelM * mr, panelN * nr, range, accumulator.data());
+                }
+            }
+        }
+
+        for (uint32_t column = 0; column < range.columns; ++column) {
+            memcpy(c + static_cast<uint64_t>(range.columnBegin + column) * shape.m + range.rowBegin,
+                accumulator.data() + static_cast<size_t>(column) * range.rows, range.rows * sizeof(uint32_t));
+        }
+    }
+
+    void RunFloatBlock(
+        const Microkernels& microkernels, const GemmShape& shape, const uint16_t* a, const uint16_t* b, void* c,
+        VkComponentTypeKHR resultType, uint32_t blockIndex) {
+        BlockRange range = GetBlockRange(shape, blockIndex);
+        uint32_t mr = microkernels.mr;
+        uint32_t nr = microkernels.nr;
+        uint32_t panelsM = DivideRoundingUp(range.rows, mr);
+        uint32_t panelsN = DivideRoundingUp(range.columns, nr);
+
+        thread_local std::vector<float> packedA;
+        thread_local std::vector<float> packedB;
+        thread_local std::vector<float> accumulator;
+        thread_local std::vector<float> tile;
+        packedA.resize(static_cast<size_t>(panelsM) * mr * kBlockK);
+        packedB.resize(static_cast<size_t>(panelsN) * nr * kBlockK);
+        accumulator.assign(static_cast<size_t>(range.rows) * range.columns, 0.0f);
+        tile.resize(static_cast<size_t>(mr) * nr);
+
+        for (uint32_t kBegin = 0; kBegin < shape.k; kBegin += kBlockK) {
+            uint32_t kCount = std::min(kBlockK, shape.k - kBegin);
+            PackFloatA(a, shape.m, range.rowBegin, range.rows, kBegin, kCount, mr, packedA.data());
+            PackFloatB(b, shape.k, range.columnBegin, range.columns, kBegin, kCount, nr, packedB.data());
+            for (uint32_t panelN = 0; panelN < panelsN; ++panelN) {
+                for (uint32_t panelM = 0; panelM < panelsM; ++panelM) {
+                    microkernels.floatMicrokernel(
+                        packedA.data() + static_cast<size_t>(panelM) * kCount * mr,
+                        packedB.data() + static_cast<size_t>(panelN) * kCount * nr, kCount, tile.data());
+                    AccumulateTile(tile.data(), mr, nr, panelM * mr, panelN * nr, range, accumulator.data());
+                }
+            }
+        }
+
+        for (uint32_t column = 0; column < range.columns; ++column) {
+            uint64_t offset = static_cast<uint64_t>(range.columnBegin + column) * shape.m + range.rowBegin;
+            for (uint32_t row = 0; row < range.rows; ++row) {
+                WriteComponent(c, resultType, offset + row, accumulator[static_cast<size_t>(column) * range.rows + row]);
+            }
+        }
+    }
+}  // anonymous namespace
+
+const char* GetCpuGemmIsaName(CpuGemmIsa isa) {
+    switch (isa) {
+        case CpuGemmIsa::Avx512Vnni:
+            return "avx512vnni";
+        case CpuGemmIsa::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+CpuGemmIsa DetectCpuGemmIsa() {
+#if CPU_GEMM_X86 && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave) {
+        return CpuGemmIsa::Scalar;
+    }
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    bool avx512f = (info[1] & (1 << 16)) != 0;
+    bool avx512bw = (info[1] & (1 << 30)) != 0;
+    bool avx512vnni = (info[2] & (1 << 11)) != 0;
+    if (avx512f && avx512bw && avx512vnni && (xcr0 & 0xE6) == 0xE6) {
+        return CpuGemmIsa::Avx512Vnni;
+    }
+    if (avx2 && fma && (xcr0 & 0x6) == 0x6) {
+        return CpuGemmIsa::Avx2;
+    }
+    return CpuGemmIsa::Scalar;
+#elif CPU_GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vnni")) {
+        return CpuGemmIsa::Avx512Vnni;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CpuGemmIsa::Avx2;
+    }
+    return CpuGemmIsa::Scalar;
+#else
+    return CpuGemmIsa::Scalar;
+#endif
+}
+
+CpuGemm::CpuGemm(ThreadPool& threadPool, const VkCooperativeMatrixPropertiesKHR& property, CpuGemmIsa isa)
+    : mThreadPool(threadPool), mProperty(property), mIsa(isa) {
+    assert(IsPropertySupported(property));
+}
+
+bool CpuGemm::IsPropertySupported(const VkCooperativeMatrixPropertiesKHR& property) {
+    if (property.AType == VK_COMPONENT_TYPE_FLOAT16_KHR) {
+        return property.BType == VK_COMPONENT_TYPE_FLOAT16_KHR &&
+            (property.ResultType == VK_COMPONENT_TYPE_FLOAT16_KHR ||
+             property.ResultType == VK_COMPONENT_TYPE_FLOAT32_KHR);
+    }
+    bool aInteger = property.AType == VK_COMPONENT_TYPE_UINT8_KHR || property.AType == VK_COMPONENT_TYPE_SINT8_KHR;
+    bool bInteger = property.BType == VK_COMPONENT_TYPE_UINT8_KHR || property.BType == VK_COMPONENT_TYPE_SINT8_KHR;
+    return aInteger && bInteger &&
+        (property.ResultType == VK_COMPONENT_TYPE_UINT32_KHR || property.ResultType == VK_COMPONENT_TYPE_SINT32_KHR);
+}
+
+std::vector<VkCooperativeMatrixPropertiesKHR> CpuGemm::GetSupportedProperties() {
+    const VkComponentTypeKHR types[][3] = {
+        { VK_COMPONENT_TYPE_FLOAT16_KHR, VK_COMPONENT_TYPE_FLOAT16_KHR, VK_COMPONENT_TYPE_FLOAT16_KHR },
+        { VK_COMPONENT_TYPE_FLOAT16_KHR, VK_COMPONENT_TYPE_FLOAT16_KHR, VK_COMPONENT_TYPE_FLOAT32_KHR },
+        { VK_COMPONENT_TYPE_SINT8_KHR, VK_COMPONENT_TYPE_SINT8_KHR, VK_COMPONENT_TYPE_SINT32_KHR },
+        { VK_COMPONENT_TYPE_SINT8_KHR, VK_COMPONENT_TYPE_UINT8_KHR, VK_COMPONENT_TYPE_SINT32_KHR },
+        { VK_COMPONENT_TYPE_UINT8_KHR, VK_COMPONENT_TYPE_SINT8_KHR, VK_COMPONENT_TYPE_SINT32_KHR },
+        { VK_COMPONENT_TYPE_UINT8_KHR, VK_COMPONENT_TYPE_UINT8_KHR, VK_COMPONENT_TYPE_UINT32_KHR },
+    };
+    std::vector<VkCooperativeMatrixPropertiesKHR> properties;
+    for (const auto& type : types) {
+        VkCooperativeMatrixPropertiesKHR property = {};
+        property.sType = VK_STRUCTURE_TYPE_COOPERATIVE_MATRIX_PROPERTIES_KHR;
+        property.MSize = kBlockM;
+        property.NSize = kBlockN;
+        property.KSize = kBlockK;
+        property.AType = type[0];
+        property.BType = type[1];
+        property.CType = type[2];
+        property.ResultType = type[2];
+        property.scope = VK_SCOPE_SUBGROUP_KHR;
+        properties.push_back(property);
+    }
+    return properties;
+}
+
+const VkCooperativeMatrixPropertiesKHR& CpuGemm::GetProperty() const {
+    return mProperty;
+}
+
+CpuGemmIsa CpuGemm::GetIsa() const {
+    return mIsa;
+}
+
+uint32_t CpuGemm::GetMicroTileM() const {
+    return GetMicrokernels(mIsa).mr;
+}
+
+uint32_t CpuGemm::GetMicroTileN() const {
+    return GetMicrokernels(mIsa).nr;
+}
+
+void CpuGemm::Run(const GemmShape& shape, const void* a, const void* b, void* c) const {
+    Microkernels microkernels = GetMicrokernels(mIsa);
+    uint32_t blockCount = DivideRoundingUp(shape.m, kBlockM) * DivideRoundingUp(shape.n, kBlockN);
+    VkComponentTypeKHR aType = mProperty.AType;
+    VkComponentTypeKHR bType = mProperty.BType;
+    uint64_t entrySizeA = static_cast<uint64_t>(shape.m) * shape.k * GetComponentTypeSize(aType);
+    uint64_t entrySizeB = static_cast<uint64_t>(shape.k) * shape.n * GetComponentTypeSize(bType);
+    uint64_t entrySizeC = static_cast<uint64_t>(shape.m) * shape.n * GetComponentTypeSize(mProperty.ResultType);
+    // Blocks of all batch entries share one loop, so small entries still fill the thread pool.
+    mThreadPool.ParallelFor(blockCount * shape.batch, [&](uint32_t index) {
+        uint32_t entry = index / blockCount;
+        uint32_t blockIndex = index % blockCount;
+        const void* entryA = static_cast<const uint8_t*>(a) + entry * entrySizeA;
+        const void* entryB = static_cast<const uint8_t*>(b) + entry * entrySizeB;
+        void* entryC = static_cast<uint8_t*>(c) + entry * entrySizeC;
+        uint32_t* integerC = static_cast<uint32_t*>(entryC);
+        if (aType == VK_COMPONENT_TYPE_FLOAT16_KHR) {
+            RunFloatBlock(microkernels, shape, static_cast<const uint16_t*>(entryA),
+                static_cast<const uint16_t*>(entryB), entryC, mProperty.ResultType, blockIndex);
+        } else if (aType == VK_COMPONENT_TYPE_UINT8_KHR && bType == VK_COMPONENT_TYPE_UINT8_KHR) {
+            RunIntegerBlock(microkernels, shape, static_cast<const uint8_t*>(entryA),
+                static_cast<const uint8_t*>(entryB), integerC, blockIndex);
+        } else if (aType == VK_COMPONENT_TYPE_UINT8_KHR) {
+            RunIntegerBlock(microkernels, shape, static_cast<const uint8_t*>(entryA),
+                static_cast<const int8_t*>(entryB), integerC, blockIndex);
+        } else if (bType == VK_COMPONENT_TYPE_UINT8_KHR) {
+            RunIntegerBlock(microkernels, shape, static_cast<const int8_t*>(entryA),
+                static_cast<const uint8_t*>(entryB), integerC, blockIndex);
+        } else {
+            RunIntegerBlock(microkernels, shape, static_cast<const int8_t*>(entryA),
+                static_cast<const int8_t*>(entryB), integerC, blockIndex);
+        }
+    });
+}
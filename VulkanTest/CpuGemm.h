@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef CPU_GEMM_H_
+#define CPU_GEMM_H_
+
+#include "GemmKernel.h"
+#include "ThreadPool.h"
+
+enum class CpuGemmIsa {
+    Scalar,
+    Avx2,
+    Avx512Vnni,
+};
+
+const char* GetCpuGemmIsaName(CpuGemmIsa isa);
+// The widest instruction set the host CPU and OS support.
+CpuGemmIsa DetectCpuGemmIsa();
+
+// Host GEMM with the same types and column-major layouts as GemmKernel: A is MxK, B is KxN and C is MxN.
+// C is split into blocks that run on the thread pool; each block packs K slices of A and B into
+// microkernel panels (8-bit inputs as pairs of int16, f16 inputs as f32) and accumulates in int32 or f32.
+// Integer results wrap modulo 2^32 like the GPU accumulators.
+class CpuGemm {
+  public:
+    CpuGemm(ThreadPool& threadPool, const VkCooperativeMatrixPropertiesKHR& property, CpuGemmIsa isa);
+
+    // Whether there is a CPU path for the component types of this configuration; tile sizes are ignored.
+    static bool IsPropertySupported(const VkCooperativeMatrixPropertiesKHR& property);
+    // Properties for every type combination the CPU path supports, in lieu of a device list.
+    static std::vector<VkCooperativeMatrixPropertiesKHR> GetSupportedProperties();
+
+    const VkCooperativeMatrixPropertiesKHR& GetProperty() const;
+    CpuGemmIsa GetIsa() const;
+    uint32_t GetMicroTileM() const;
+    uint32_t GetMicroTileN() const;
+
+    // Batch entries are stored back to back, see GetPackedBatchStrides().
+    void Run(const GemmShape& shape, const void* a, const void* b, void* c) const;
+
+  private:
+    ThreadPool& mThreadPool;
+    VkCooperativeMatrixPropertiesKHR mProperty;
+    CpuGemmIsa mIsa;
+};
+
+#endif
@@ -0,0 +1,812 @@
+#include "GemmBenchmark.h"
+
+#include "Verification.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace {
+    constexpr uint32_t kMaxPrintedDimension = 32;
+    // Results with a fused epilogue are checked element by element, see VerifyGemmEpilogueSamples().
+    constexpr uint32_t kEpilogueSamplesPerTrial = 256;
+    // A, B and C can be passed to descriptor and device address kernels alike.
+    constexpr VkBufferUsageFlags kOperandBufferUsage =
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+    // A zero point inside the range of an 8-bit integer component type.
+    int32_t DrawZeroPoint(VkComponentTypeKHR componentType, std::mt19937& random) {
+        bool signedComponent = componentType == VK_COMPONENT_TYPE_SINT8_KHR;
+        std::uniform_int_distribution<int32_t> distribution(signedComponent ? -128 : 0, signedComponent ? 127 : 255);
+        return distribution(random);
+    }
+
+    // Verification takes column-major operands; row-major ones are transposed into scratch first.
+    const void* GetColumnMajor(
+        GemmLayout layout, const void* data, uint32_t rows, uint32_t columns, uint32_t batch, uint32_t elementSize,
+        std::vector<uint8_t>& scratch) {
+        if (layout == GemmLayout::ColumnMajor) {
+            return data;
+        }
+        scratch.resize(static_cast<size_t>(rows) * columns * batch * elementSize);
+        TransposeToColumnMajor(data, rows, columns, batch, elementSize, scratch.data());
+        return scratch.data();
+    }
+
+    void RecordComputeToComputeBarrier(VkCommandBuffer commandBuffer, const VulkanBuffer& outputBuffer) {
+        RecordBufferBarrier(
+            commandBuffer, outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, outputBuffer.GetSize());
+    }
+
+    // Device address kernels take the buffers with the dispatch; descriptor kernels read the ones bound to
+    // descriptorSet, including the split-K workspace when splitK is above 1 and the bias. biasBuffer is null
+    // unless the kernel has an epilogue bias.
+    void RecordGemmDispatch(
+        VkCommandBuffer commandBuffer, const GemmKernel& gemmKernel, const GemmShape& shape, uint32_t splitK,
+        const VulkanBuffer& inputBuffer1, const VulkanBuffer& inputBuffer2, const VulkanBuffer& outputBuffer,
+        const VulkanBuffer* biasBuffer, uint32_t descriptorSet = 0) {
+        if (gemmKernel.GetConfig().deviceAddress) {
+            GemmBufferAddresses addresses = {
+                inputBuffer1.GetDeviceAddress(), inputBuffer2.GetDeviceAddress(), outputBuffer.GetDeviceAddress(),
+                biasBuffer != nullptr ? biasBuffer->GetDeviceAddress() : 0 };
+            gemmKernel.RecordDispatch(commandBuffer, shape, addresses);
+        } else if (splitK > 1) {
+            gemmKernel.RecordSplitKDispatch(commandBuffer, shape, splitK, descriptorSet);
+        } else {
+            gemmKernel.RecordDispatch(commandBuffer, shape, descriptorSet);
+        }
+    }
+
+    // Bytes of the inputs and the result. VulkanBuffer::GetSize() is the size of the memory requirements, which
+    // may be larger, so copies go by these.
+    struct OperandSizes {
+        VkDeviceSize input1 = 0;
+        VkDeviceSize input2 = 0;
+        VkDeviceSize output = 0;
+    };
+
+    // The staging buffer holds input 1 followed by input 2.
+    void RecordInputCopies(
+        VkCommandBuffer commandBuffer, const OperandSizes& sizes, const VulkanBuffer& stagingBuffer,
+        const VulkanBuffer& inputBuffer1, const VulkanBuffer& inputBuffer2) {
+        VkBufferCopy bufferCopy = {};
+        bufferCopy.size = sizes.input1;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer.GetVkBuffer(), inputBuffer1.GetVkBuffer(), 1, &bufferCopy);
+        bufferCopy.srcOffset = sizes.input1;
+        bufferCopy.size = sizes.input2;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer.GetVkBuffer(), inputBuffer2.GetVkBuffer(), 1, &bufferCopy);
+    }
+
+    // One latency-bound iteration: upload both inputs from the staging buffer, run the kernel and read the
+    // result back.
+    void RecordRoundTrip(
+        VkCommandBuffer commandBuffer, const GemmKernel& gemmKernel, const GemmShape& shape, uint32_t splitK,
+        const OperandSizes& sizes, const VulkanBuffer& stagingBuffer, const VulkanBuffer& inputBuffer1,
+        const VulkanBuffer& inputBuffer2, const VulkanBuffer& outputBuffer, const VulkanBuffer& readbackBuffer,
+        const VulkanBuffer* biasBuffer) {
+        RecordInputCopies(commandBuffer, sizes, stagingBuffer, inputBuffer1, inputBuffer2);
+        RecordBufferBarrier(
+            commandBuffer, inputBuffer1.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT, inputBuffer1.GetSize());
+        RecordBufferBarrier(
+            commandBuffer, inputBuffer2.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT, inputBuffer2.GetSize());
+
+        RecordGemmDispatch(
+            commandBuffer, gemmKernel, shape, splitK, inputBuffer1, inputBuffer2, outputBuffer, biasBuffer);
+
+        RecordBufferBarrier(
+            commandBuffer, outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT, outputBuffer.GetSize());
+        VkBufferCopy bufferCopy = {};
+        bufferCopy.size = sizes.output;
+        vkCmdCopyBuffer(commandBuffer, outputBuffer.GetVkBuffer(), readbackBuffer.GetVkBuffer(), 1, &bufferCopy);
+    }
+
+    // Buffers of one tile in flight, bound to the kernel descriptor set of the same index unless the kernel takes
+    // device addresses.
+    struct StreamingSlot {
+        VulkanBuffer inputBuffer1;
+        VulkanBuffer inputBuffer2;
+        VulkanBuffer outputBuffer;
+        VulkanBuffer readbackBuffer;
+        VulkanSubmitTicket computeTicket;
+        VulkanSubmitTicket readbackTicket;
+    };
+
+    // Uploads, computes and reads back tileCount tiles, cycling through the slots, and returns the host time
+    // until the last readback completed. Copies run on the transfer queue and hand the buffers over to the
+    // compute queue and back through timeline semaphores and queue family ownership transfers, so the upload
+    // of the next tile and the readback of the previous one overlap with the dispatch. With serialize set,
+    // every tile is waited for before the next one is submitted.
+    double StreamTiles(
+        const VulkanRuntime& vulkanRuntime, const GemmKernel& gemmKernel, const GemmShape& shape, uint32_t splitK,
+        const OperandSizes& sizes, const VulkanBuffer& stagingBuffer, const VulkanBuffer* biasBuffer,
+        std::vector<StreamingSlot>& slots, uint32_t tileCount, bool serialize) {
+        uint32_t transferFamily = vulkanRuntime.GetQueueFamilyIndex(VulkanQueueType::Transfer);
+        uint32_t computeFamily = vulkanRuntime.GetQueueFamilyIndex(VulkanQueueType::Compute);
+        bool transferOwnership = transferFamily != computeFamily;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t tile = 0; tile < tileCount; ++tile) {
+            uint32_t slotIndex = tile % static_cast<uint32_t>(slots.size());
+            StreamingSlot& slot = slots[slotIndex];
+
+            // The inputs are overwritten once the previous dispatch of this slot has read them, so ownership
+            // does not have to be transferred back to the transfer queue.
+            VkCommandBuffer commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer(VulkanQueueType::Transfer);
+            RecordInputCopies(commandBuffer, sizes, stagingBuffer, slot.inputBuffer1, slot.inputBuffer2);
+            if (transferOwnership) {
+                for (const VulkanBuffer* buffer : { &slot.inputBuffer1, &slot.inputBuffer2 }) {
+                    RecordBufferOwnershipTransfer(
+                        commandBuffer, buffer->GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferFamily,
+                        computeFamily);
+                }
+            }
+            VulkanSubmitTicket uploadTicket = vulkanRuntime.SubmitAsync(commandBuffer, { slot.computeTicket });
+
+            commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer(VulkanQueueType::Compute);
+            if (transferOwnership) {
+                for (const VulkanBuffer* buffer : { &slot.inputBuffer1, &slot.inputBuffer2 }) {
+                    RecordBufferOwnershipTransfer(
+                        commandBuffer, buffer->GetVkBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_ACCESS_SHADER_READ_BIT, transferFamily,
+                        computeFamily);
+                }
+            }
+            RecordGemmDispatch(
+                commandBuffer, gemmKernel, shape, splitK, slot.inputBuffer1, slot.inputBuffer2, slot.outputBuffer,
+                biasBuffer, slotIndex);
+            if (transferOwnership) {
+                RecordBufferOwnershipTransfer(
+                    commandBuffer, slot.outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_SHADER_WRITE_BIT, 0, computeFamily,
+                    transferFamily);
+            }
+            // The output is overwritten once the previous readback of this slot has copied it.
+            slot.computeTicket = vulkanRuntime.SubmitAsync(commandBuffer, { uploadTicket, slot.readbackTicket });
+
+            commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer(VulkanQueueType::Transfer);
+            if (transferOwnership) {
+                RecordBufferOwnershipTransfer(
+                    commandBuffer, slot.outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT, computeFamily, transferFamily);
+            }
+            VkBufferCopy bufferCopy = {};
+            bufferCopy.size = sizes.output;
+            vkCmdCopyBuffer(
+                commandBuffer, slot.outputBuffer.GetVkBuffer(), slot.readbackBuffer.GetVkBuffer(), 1, &bufferCopy);
+            slot.readbackTicket = vulkanRuntime.SubmitAsync(commandBuffer, { slot.computeTicket });
+
+            if (serialize) {
+                vulkanRuntime.Wait(slot.readbackTicket);
+            }
+        }
+        for (const StreamingSlot& slot : slots) {
+            vulkanRuntime.Wait(slot.readbackTicket);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+}  // anonymous namespace
+
+BenchmarkResult RunGemmBenchmark(
+    VulkanRuntime& vulkanRuntime, GemmKernel& gemmKernel, const GemmShape& shape,
+    const BenchmarkOptions& options) {
+    const VkCooperativeMatrixPropertiesKHR& property = gemmKernel.GetProperty();
+    BenchmarkResult result;
+    result.type = GemmKernel::GetShaderVariantName(property);
+    result.tile = std::to_string(property.MSize) + "x" + std::to_string(property.NSize) + "x" +
+        std::to_string(property.KSize);
+    result.kernel = gemmKernel.GetKernelName();
+    uint32_t splitK = options.splitK == 0 ? gemmKernel.GetSplitKFactor(shape) : options.splitK;
+    if (splitK > 1) {
+        result.kernel += "_split" + std::to_string(splitK);
+    }
+    result.shape = shape;
+    result.name = result.type + "/" + result.tile + "/" + GetShapeName(shape) + "/" + result.kernel;
+    result.repetitions = options.repetitions;
+    if (!gemmKernel.IsSplitKSupported(shape, splitK)) {
+        printf("Skipping %s: K cannot be split %u ways by the kernel\n", result.name.c_str(), splitK);
+        result.skipped = true;
+        return result;
+    }
+
+    // Batch entries are packed back to back.
+    uint64_t elementCount1 = static_cast<uint64_t>(shape.m) * shape.k * shape.batch;
+    uint64_t elementCount2 = static_cast<uint64_t>(shape.k) * shape.n * shape.batch;
+    VkDeviceSize inputBufferSize1 = elementCount1 * GetComponentTypeSize(property.AType);
+    // Packed 4-bit B takes half a byte per element plus a float scale per group.
+    const uint32_t int4GroupSize = gemmKernel.GetConfig().int4GroupSize;
+    VkDeviceSize inputBufferSize2 =
+        int4GroupSize != 0 ? elementCount2 / 2 : elementCount2 * GetComponentTypeSize(property.BType);
+    VkDeviceSize scalesBufferSize = int4GroupSize != 0 ? elementCount2 / int4GroupSize * sizeof(float) : 0;
+    VkComponentTypeKHR outputType = gemmKernel.GetOutputComponentType();
+    VkDeviceSize outputBufferSize =
+        static_cast<VkDeviceSize>(shape.m) * shape.n * shape.batch * GetComponentTypeSize(outputType);
+    const bool hasBias = gemmKernel.GetConfig().epilogue.bias;
+    VkDeviceSize biasBufferSize = hasBias ? shape.n * GetComponentTypeSize(property.ResultType) : 0;
+    const GemmZeroPoints zeroPoints = gemmKernel.GetConfig().epilogue.zeroPoints;
+    VkDeviceSize zeroPointsBufferSize = zeroPoints == GemmZeroPoints::PerColumn ? shape.n * sizeof(int32_t) : 0;
+    result.kernelBytes = inputBufferSize1 + inputBufferSize2 + outputBufferSize + biasBufferSize +
+        zeroPointsBufferSize + scalesBufferSize;
+    auto setupStart = std::chrono::steady_clock::now();
+    VulkanBuffer inputBuffer1 = vulkanRuntime.CreateBuffer(
+        inputBufferSize1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | kOperandBufferUsage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer inputBuffer2 = vulkanRuntime.CreateBuffer(
+        inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_DST_BIT | kOperandBufferUsage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer outputBuffer = vulkanRuntime.CreateBuffer(
+        outputBufferSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        kOperandBufferUsage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer readbackBuffer = vulkanRuntime.CreateBuffer(
+        outputBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    // Shared by every descriptor set and streaming slot, as it is only read.
+    std::unique_ptr<VulkanBuffer> biasBuffer;
+    if (hasBias) {
+        biasBuffer = std::make_unique<VulkanBuffer>(vulkanRuntime.CreateBuffer(
+            biasBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | kOperandBufferUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        if (!gemmKernel.GetConfig().deviceAddress) {
+            for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+                gemmKernel.BindBias(*biasBuffer, i);
+            }
+        }
+    }
+    std::unique_ptr<VulkanBuffer> zeroPointsBuffer;
+    if (zeroPoints == GemmZeroPoints::PerColumn) {
+        zeroPointsBuffer = std::make_unique<VulkanBuffer>(vulkanRuntime.CreateBuffer(
+            zeroPointsBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+            gemmKernel.BindZeroPointsB(*zeroPointsBuffer, i);
+        }
+    }
+    // GPU packing uploads the column-major operands here and packs them into inputBuffer1 and inputBuffer2.
+    const bool gpuPacking = options.packing == BenchmarkPacking::Gpu;
+    std::unique_ptr<VulkanBuffer> unpackedBuffer1;
+    std::unique_ptr<VulkanBuffer> unpackedBuffer2;
+    if (gpuPacking) {
+        unpackedBuffer1 = std::make_unique<VulkanBuffer>(vulkanRuntime.CreateBuffer(
+            inputBufferSize1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        unpackedBuffer2 = std::make_unique<VulkanBuffer>(vulkanRuntime.CreateBuffer(
+            inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        gemmKernel.BindUnpackedOperands(*unpackedBuffer1, *unpackedBuffer2);
+    }
+    std::unique_ptr<VulkanBuffer> scalesBuffer;
+    if (int4GroupSize != 0) {
+        scalesBuffer = std::make_unique<VulkanBuffer>(vulkanRuntime.CreateBuffer(
+            scalesBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+            gemmKernel.BindWeightScales(*scalesBuffer, i);
+        }
+    }
+    // One set of quantization sums and one workspace per descriptor set, as the streaming slots of both sets are
+    // in flight at once.
+    std::vector<VulkanBuffer> quantizationSums;
+    if (zeroPoints != GemmZeroPoints::None) {
+        for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+            quantizationSums.push_back(vulkanRuntime.CreateBuffer(
+                gemmKernel.GetQuantizationSumsSize(shape), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+            gemmKernel.BindQuantizationSums(quantizationSums.back(), i);
+        }
+    }
+    std::vector<VulkanBuffer> splitKWorkspaces;
+    if (splitK > 1) {
+        for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+            splitKWorkspaces.push_back(vulkanRuntime.CreateBuffer(
+                gemmKernel.GetSplitKWorkspaceSize(shape, splitK), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+            gemmKernel.BindSplitKWorkspace(splitKWorkspaces.back(), i);
+        }
+    }
+
+    result.setupNanoseconds = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - setupStart).count();
+
+    // The inputs stay on the host for verification and are streamed through the runtime staging ring.
+    std::vector<uint8_t> inputData1(inputBufferSize1);
+    std::vector<uint8_t> inputData2(inputBufferSize2);
+    FillRandomComponents(inputData1.data(), property.AType, elementCount1, options.seed);
+    std::vector<float> scalesData(scalesBufferSize / sizeof(float));
+    if (int4GroupSize != 0) {
+        // The whole 4-bit range, scaled to within [-1, 1] like the float inputs. Batch entries are back to back,
+        // so they pack like further columns.
+        std::vector<int8_t> weights(elementCount2);
+        std::mt19937 weightRandom(options.seed + 1);
+        std::uniform_int_distribution<int32_t> weightDistribution(-8, 7);
+        for (int8_t& weight : weights) {
+            weight = static_cast<int8_t>(weightDistribution(weightRandom));
+        }
+        PackInt4Weights(weights.data(), shape.k, shape.n * shape.batch, inputData2.data());
+        std::uniform_real_distribution<float> scaleDistribution(1.0f / 16, 1.0f / 8);
+        for (float& scale : scalesData) {
+            scale = scaleDistribution(weightRandom);
+        }
+    } else {
+        FillRandomComponents(inputData2.data(), property.BType, elementCount2, options.seed + 1);
+    }
+    // A bias on the order of the accumulators rather than of the whole 32-bit range.
+    std::vector<int32_t> biasData(hasBias ? shape.n : 0);
+    std::mt19937 biasRandom(options.seed + 4);
+    std::uniform_int_distribution<int32_t> biasDistribution(-(1 << 16), 1 << 16);
+    for (int32_t& value : biasData) {
+        value = biasDistribution(biasRandom);
+    }
+    // Verification reads the column-major inputs; round trips and streamed tiles upload the operands in the
+    // layout the kernel reads, packed on the host even with GPU packing.
+    std::vector<uint8_t> packedData1;
+    std::vector<uint8_t> packedData2;
+    if (gemmKernel.GetConfig().packedOperands) {
+        packedData1.resize(inputBufferSize1);
+        packedData2.resize(inputBufferSize2);
+        ThreadPool threadPool(options.cpuThreads);
+        auto packStart = std::chrono::steady_clock::now();
+        PackOperandTiles(threadPool, property, GemmOperand::A, shape, inputData1.data(), packedData1.data());
+        PackOperandTiles(threadPool, property, GemmOperand::B, shape, inputData2.data(), packedData2.data());
+        result.packNanoseconds = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - packStart).count();
+    }
+    const uint8_t* kernelData1 = packedData1.empty() ? inputData1.data() : packedData1.data();
+    const uint8_t* kernelData2 = packedData2.empty() ? inputData2.data() : packedData2.data();
+    GemmEpilogueParameters epilogueParameters = options.epilogueParameters;
+    std::vector<int32_t> zeroPointsData(zeroPoints == GemmZeroPoints::PerColumn ? shape.n : 0);
+    if (zeroPoints != GemmZeroPoints::None) {
+        std::mt19937 zeroPointRandom(options.seed + 5);
+        epilogueParameters.zeroPointA = DrawZeroPoint(property.AType, zeroPointRandom);
+        epilogueParameters.zeroPointB = DrawZeroPoint(property.BType, zeroPointRandom);
+        for (int32_t& value : zeroPointsData) {
+            value = DrawZeroPoint(property.BType, zeroPointRandom);
+        }
+    }
+    gemmKernel.SetEpilogueParameters(epilogueParameters);
+
+    auto uploadStart = std::chrono::steady_clock::now();
+    VulkanStagingRing& stagingRing = vulkanRuntime.GetStagingRing();
+    const VulkanBuffer& uploadBuffer1 = gpuPacking ? *unpackedBuffer1 : inputBuffer1;
+    const VulkanBuffer& uploadBuffer2 = gpuPacking ? *unpackedBuffer2 : inputBuffer2;
+    stagingRing.Upload(uploadBuffer1, 0, gpuPacking ? inputData1.data() : kernelData1, inputBufferSize1);
+    stagingRing.Upload(uploadBuffer2, 0, gpuPacking ? inputData2.data() : kernelData2, inputBufferSize2);
+    if (hasBias) {
+        stagingRing.Upload(*biasBuffer, 0, biasData.data(), biasBufferSize);
+    }
+    if (zeroPointsBuffer) {
+        stagingRing.Upload(*zeroPointsBuffer, 0, zeroPointsData.data(), zeroPointsBufferSize);
+    }
+    if (scalesBuffer) {
+        stagingRing.Upload(*scalesBuffer, 0, scalesData.data(), scalesBufferSize);
+    }
+    stagingRing.Wait();
+    result.uploadNanoseconds = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - uploadStart).count();
+
+    if (!gemmKernel.GetConfig().deviceAddress) {
+        gemmKernel.BindBuffers(inputBuffer1, inputBuffer2, outputBuffer);
+    }
+
+    VulkanProfiler profiler = vulkanRuntime.CreateProfiler(options.repetitions);
+    result.gpuTimestamps = profiler.IsSupported();
+
+    // The staging copies were submitted earlier on the same queue, so these barriers cover them.
+    VkCommandBuffer commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+    RecordBufferBarrier(
+        commandBuffer, uploadBuffer1.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT, uploadBuffer1.GetSize());
+    RecordBufferBarrier(
+        commandBuffer, uploadBuffer2.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT, uploadBuffer2.GetSize());
+    if (gpuPacking) {
+        profiler.Reset(commandBuffer);
+        profiler.BeginRegion(commandBuffer, "pack");
+        gemmKernel.RecordPackOperands(commandBuffer, shape, true, true);
+        profiler.EndRegion(commandBuffer);
+    }
+
+    for (uint32_t i = 0; i < options.warmupIterations; ++i) {
+        RecordGemmDispatch(
+            commandBuffer, gemmKernel, shape, splitK, inputBuffer1, inputBuffer2, outputBuffer, biasBuffer.get());
+        RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+    }
+    vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+    if (gpuPacking) {
+        result.packNanoseconds = result.gpuTimestamps ? profiler.GetResults()[0].nanoseconds : 0.0;
+    }
+
+    // All measured dispatches go into one submission, separated by barriers so they do not overlap.
+    std::vector<double> samples;
+    if (result.gpuTimestamps) {
+        commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+        profiler.Reset(commandBuffer);
+        for (uint32_t i = 0; i < options.repetitions; ++i) {
+            profiler.BeginRegion(commandBuffer, "compute");
+            RecordGemmDispatch(
+                commandBuffer, gemmKernel, shape, splitK, inputBuffer1, inputBuffer2, outputBuffer, biasBuffer.get());
+            profiler.EndRegion(commandBuffer);
+            RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+        }
+        vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+        for (const VulkanProfilerRegion& region : profiler.GetResults()) {
+            samples.push_back(region.nanoseconds);
+        }
+    } else {
+        for (uint32_t i = 0; i < options.repetitions; ++i) {
+            commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+            RecordGemmDispatch(
+                commandBuffer, gemmKernel, shape, splitK, inputBuffer1, inputBuffer2, outputBuffer, biasBuffer.get());
+            RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+            auto start = std::chrono::steady_clock::now();
+            vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+    }
+    result.kernelNanoseconds = ComputeStatistics(samples);
+
+    commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+    profiler.Reset(commandBuffer);
+    RecordBufferBarrier(
+        commandBuffer, outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT, outputBuffer.GetSize());
+    profiler.BeginRegion(commandBuffer, "readback");
+    VkBufferCopy bufferCopy = {};
+    bufferCopy.size = outputBufferSize;
+    vkCmdCopyBuffer(commandBuffer, outputBuffer.GetVkBuffer(), readbackBuffer.GetVkBuffer(), 1, &bufferCopy);
+    profiler.EndRegion(commandBuffer);
+    vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+    if (result.gpuTimestamps) {
+        result.readbackNanoseconds = profiler.GetResults()[0].nanoseconds;
+    }
+
+    readbackBuffer.InvalidateMappedData();
+    const void* readbackPtr = readbackBuffer.GetMappedData();
+
+    if (options.printResult && shape.m <= kMaxPrintedDimension && shape.n <= kMaxPrintedDimension) {
+        // Printed row by row, whatever the layout of C.
+        bool rowMajorC = gemmKernel.GetConfig().layoutC == GemmLayout::RowMajor;
+        printf("%s output data (first batch entry): \n", result.name.c_str());
+        for (uint32_t y = 0; y < shape.m; ++y) {
+            for (uint32_t x = 0; x < shape.n; ++x) {
+                uint32_t index = rowMajorC ? y * shape.n + x : x * shape.m + y;
+                printf("%g ", ReadComponent(readbackPtr, outputType, index));
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    const GemmKernelConfig& kernelConfig = gemmKernel.GetConfig();
+    std::vector<uint8_t> columnMajorA;
+    std::vector<uint8_t> columnMajorB;
+    std::vector<uint8_t> columnMajorC;
+    const void* verifiedA = GetColumnMajor(kernelConfig.layoutA, inputData1.data(), shape.m, shape.k, shape.batch,
+        GetComponentTypeSize(property.AType), columnMajorA);
+    const void* verifiedB = GetColumnMajor(kernelConfig.layoutB, inputData2.data(), shape.k, shape.n, shape.batch,
+        GetComponentTypeSize(property.BType), columnMajorB);
+    const void* verifiedC = GetColumnMajor(kernelConfig.layoutC, readbackPtr, shape.m, shape.n, shape.batch,
+        GetComponentTypeSize(outputType), columnMajorC);
+    if (options.verificationTrials == 0) {
+        result.verified = true;
+    } else if (gemmKernel.HasEpilogue()) {
+        result.verified = VerifyGemmEpilogueSamples(
+            property, shape, kernelConfig.epilogue, epilogueParameters, verifiedA, verifiedB, biasData.data(),
+            zeroPointsData.data(), verifiedC, options.verificationTrials * kEpilogueSamplesPerTrial,
+            options.seed + 2);
+    } else if (int4GroupSize != 0) {
+        std::vector<uint16_t> dequantized(elementCount2);
+        DequantizeInt4Weights(inputData2.data(), scalesData.data(), elementCount2, int4GroupSize, dequantized.data());
+        result.verified = VerifyGemmFreivalds(property, shape, verifiedA, dequantized.data(), verifiedC,
+            options.verificationTrials, options.seed + 2);
+    } else {
+        result.verified = VerifyGemmFreivalds(property, shape, verifiedA, verifiedB, verifiedC,
+            options.verificationTrials, options.seed + 2);
+    }
+    if (!options.measureTransfers) {
+        return result;
+    }
+
+    // Round trips reuse one persistently mapped copy of the inputs, so they measure submission and
+    // transfer latency rather than host data preparation.
+    VulkanBuffer roundTripStagingBuffer = vulkanRuntime.CreateBuffer(
+        inputBufferSize1 + inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    uint8_t* stagingBytes = static_cast<uint8_t*>(roundTripStagingBuffer.GetMappedData());
+    memcpy(stagingBytes, kernelData1, inputBufferSize1);
+    memcpy(stagingBytes + inputBufferSize1, kernelData2, inputBufferSize2);
+    roundTripStagingBuffer.FlushMappedData();
+    const OperandSizes operandSizes = { inputBufferSize1, inputBufferSize2, outputBufferSize };
+
+    std::vector<double> roundTripSamples;
+    VkCommandBuffer roundTrip = VK_NULL_HANDLE;
+    if (options.replayCommandBuffers) {
+        roundTrip = vulkanRuntime.CreateAndBeginCommandBuffer();
+        RecordRoundTrip(roundTrip, gemmKernel, shape, splitK, operandSizes, roundTripStagingBuffer, inputBuffer1,
+            inputBuffer2, outputBuffer, readbackBuffer, biasBuffer.get());
+        vulkanRuntime.EndReplayableCommandBuffer(roundTrip);
+    }
+    for (uint32_t i = 0; i < options.repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (options.replayCommandBuffers) {
+            vulkanRuntime.Wait(vulkanRuntime.Replay(roundTrip));
+        } else {
+            commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+            RecordRoundTrip(commandBuffer, gemmKernel, shape, splitK, operandSizes, roundTripStagingBuffer,
+                inputBuffer1, inputBuffer2, outputBuffer, readbackBuffer, biasBuffer.get());
+            vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+        }
+        auto end = std::chrono::steady_clock::now();
+        roundTripSamples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    if (roundTrip != VK_NULL_HANDLE) {
+        vulkanRuntime.FreeCommandBuffer(roundTrip);
+    }
+    result.roundTripNanoseconds = ComputeStatistics(roundTripSamples);
+
+    std::vector<StreamingSlot> streamingSlots;
+    streamingSlots.reserve(GemmKernel::kDescriptorSetCount);
+    for (uint32_t i = 0; i < GemmKernel::kDescriptorSetCount; ++i) {
+        streamingSlots.push_back({
+            vulkanRuntime.CreateBuffer(
+                inputBufferSize1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | kOperandBufferUsage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+            vulkanRuntime.CreateBuffer(
+                inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_DST_BIT | kOperandBufferUsage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+            vulkanRuntime.CreateBuffer(
+                outputBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | kOperandBufferUsage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+            vulkanRuntime.CreateBuffer(
+                outputBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT),
+            {},
+            {},
+        });
+        const StreamingSlot& slot = streamingSlots.back();
+        if (!gemmKernel.GetConfig().deviceAddress) {
+            gemmKernel.BindBuffers(slot.inputBuffer1, slot.inputBuffer2, slot.outputBuffer, i);
+        }
+    }
+    // The round trips read their staging buffer on the compute queue family. Streaming reads its own copy on the
+    // transfer queue family, so neither buffer needs a queue family ownership transfer.
+    VulkanBuffer streamingStagingBuffer = vulkanRuntime.CreateBuffer(
+        inputBufferSize1 + inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    memcpy(streamingStagingBuffer.GetMappedData(), stagingBytes, inputBufferSize1 + inputBufferSize2);
+    streamingStagingBuffer.FlushMappedData();
+    uint32_t tileCount = std::max(options.repetitions, GemmKernel::kDescriptorSetCount);
+    double serializedNanoseconds = StreamTiles(
+        vulkanRuntime, gemmKernel, shape, splitK, operandSizes, streamingStagingBuffer, biasBuffer.get(),
+        streamingSlots, tileCount, true);
+    double streamedNanoseconds = StreamTiles(
+        vulkanRuntime, gemmKernel, shape, splitK, operandSizes, streamingStagingBuffer, biasBuffer.get(),
+        streamingSlots, tileCount, false);
+    result.streamingNanoseconds = streamedNanoseconds / tileCount;
+    result.streamingOverlap = serializedNanoseconds > 0.0 ?
+        std::max(0.0, 1.0 - streamedNanoseconds / serializedNanoseconds) : 0.0;
+
+    return result;
+}
+
+BenchmarkResult RunGroupedGemmBenchmark(
+    VulkanRuntime& vulkanRuntime, GemmKernel& gemmKernel, const GemmShape& shape,
+    const BenchmarkOptions& options) {
+    const VkCooperativeMatrixPropertiesKHR& property = gemmKernel.GetProperty();
+    uint32_t aSize = GetComponentTypeSize(property.AType);
+    uint32_t bSize = GetComponentTypeSize(property.BType);
+    uint32_t cSize = GetComponentTypeSize(property.ResultType);
+
+    // Stands in for the routing pass of a mixture-of-experts layer: every expert gets a random number of
+    // rows, possibly none, and its own B. The first expert gets at least one tile so there is always work.
+    std::mt19937 random(options.seed + 3);
+    std::uniform_int_distribution<uint32_t> tileDistribution(0, 2 * shape.m / property.MSize);
+    std::vector<GemmGroup> groups(options.groupCount);
+    uint32_t totalM = 0;
+    for (uint32_t i = 0; i < options.groupCount; ++i) {
+        GemmGroup& group = groups[i];
+        group.m = std::max(tileDistribution(random), i == 0 ? 1u : 0u) * property.MSize;
+        group.n = shape.n;
+        group.k = shape.k;
+        group.offsetA = totalM * shape.k;
+        group.offsetB = i * shape.k * shape.n;
+        group.offsetC = totalM * shape.n;
+        totalM += group.m;
+    }
+
+    BenchmarkResult result;
+    result.type = GemmKernel::GetShaderVariantName(property);
+    result.tile = std::to_string(property.MSize) + "x" + std::to_string(property.NSize) + "x" +
+        std::to_string(property.KSize);
+    result.kernel = gemmKernel.GetKernelName();
+    // The throughput counts the rows of all groups.
+    result.shape = { totalM, shape.n, shape.k };
+    result.name = result.type + "/" + result.tile + "/" + GetShapeName(shape) + "g" +
+        std::to_string(options.groupCount) + "/" + result.kernel;
+    result.repetitions = options.repetitions;
+    if (!gemmKernel.IsGroupedDispatchSupported(groups)) {
+        printf("Skipping %s: groups not supported by the kernel\n", result.name.c_str());
+        result.skipped = true;
+        return result;
+    }
+
+    uint64_t elementCount1 = static_cast<uint64_t>(totalM) * shape.k;
+    uint64_t elementCount2 = static_cast<uint64_t>(options.groupCount) * shape.k * shape.n;
+    VkDeviceSize inputBufferSize1 = elementCount1 * aSize;
+    VkDeviceSize inputBufferSize2 = elementCount2 * bSize;
+    VkDeviceSize outputBufferSize = static_cast<VkDeviceSize>(totalM) * shape.n * cSize;
+    VkDeviceSize groupTableSize = groups.size() * sizeof(GemmGroup);
+    result.kernelBytes = inputBufferSize1 + inputBufferSize2 + outputBufferSize;
+
+    auto setupStart = std::chrono::steady_clock::now();
+    VulkanBuffer inputBuffer1 = vulkanRuntime.CreateBuffer(
+        inputBufferSize1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer inputBuffer2 = vulkanRuntime.CreateBuffer(
+        inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer outputBuffer = vulkanRuntime.CreateBuffer(
+        outputBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer readbackBuffer = vulkanRuntime.CreateBuffer(
+        outputBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    VulkanBuffer groupTableBuffer = vulkanRuntime.CreateBuffer(
+        groupTableSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VulkanBuffer dispatchArgumentsBuffer = vulkanRuntime.CreateBuffer(
+        sizeof(VkDispatchIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    result.setupNanoseconds = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - setupStart).count();
+
+    std::vector<uint8_t> inputData1(inputBufferSize1);
+    std::vector<uint8_t> inputData2(inputBufferSize2);
+    FillRandomComponents(inputData1.data(), property.AType, elementCount1, options.seed);
+    FillRandomComponents(inputData2.data(), property.BType, elementCount2, options.seed + 1);
+
+    auto uploadStart = std::chrono::steady_clock::now();
+    VulkanStagingRing& stagingRing = vulkanRuntime.GetStagingRing();
+    stagingRing.Upload(inputBuffer1, 0, inputData1.data(), inputBufferSize1);
+    stagingRing.Upload(inputBuffer2, 0, inputData2.data(), inputBufferSize2);
+    stagingRing.Upload(groupTableBuffer, 0, groups.data(), groupTableSize);
+    stagingRing.Wait();
+    result.uploadNanoseconds = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - uploadStart).count();
+
+    gemmKernel.BindBuffers(inputBuffer1, inputBuffer2, outputBuffer);
+    gemmKernel.BindGroupTable(groupTableBuffer, dispatchArgumentsBuffer);
+    uint32_t groupCount = options.groupCount;
+
+    VulkanProfiler profiler = vulkanRuntime.CreateProfiler(options.repetitions);
+    result.gpuTimestamps = profiler.IsSupported();
+
+    VkCommandBuffer commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+    for (const VulkanBuffer* buffer : { &inputBuffer1, &inputBuffer2, &groupTableBuffer }) {
+        RecordBufferBarrier(
+            commandBuffer, buffer->GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, buffer->GetSize());
+    }
+    for (uint32_t i = 0; i < options.warmupIterations; ++i) {
+        gemmKernel.RecordGroupedDispatch(commandBuffer, groupCount);
+        RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+    }
+    vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+
+    // Every sample covers the prologue and the indirect dispatch.
+    std::vector<double> samples;
+    if (result.gpuTimestamps) {
+        commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+        profiler.Reset(commandBuffer);
+        for (uint32_t i = 0; i < options.repetitions; ++i) {
+            profiler.BeginRegion(commandBuffer, "grouped");
+            gemmKernel.RecordGroupedDispatch(commandBuffer, groupCount);
+            profiler.EndRegion(commandBuffer);
+            RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+        }
+        vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+        for (const VulkanProfilerRegion& region : profiler.GetResults()) {
+            samples.push_back(region.nanoseconds);
+        }
+    } else {
+        for (uint32_t i = 0; i < options.repetitions; ++i) {
+            commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+            gemmKernel.RecordGroupedDispatch(commandBuffer, groupCount);
+            RecordComputeToComputeBarrier(commandBuffer, outputBuffer);
+            auto start = std::chrono::steady_clock::now();
+            vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+    }
+    result.kernelNanoseconds = ComputeStatistics(samples);
+
+    commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
+    RecordBufferBarrier(
+        commandBuffer, outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT, outputBuffer.GetSize());
+    VkBufferCopy bufferCopy = {};
+    bufferCopy.size = outputBufferSize;
+    vkCmdCopyBuffer(commandBuffer, outputBuffer.GetVkBuffer(), readbackBuffer.GetVkBuffer(), 1, &bufferCopy);
+    vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+    readbackBuffer.InvalidateMappedData();
+    const uint8_t* readbackBytes = static_cast<const uint8_t*>(readbackBuffer.GetMappedData());
+
+    result.verified = true;
+    for (uint32_t i = 0; i < groupCount && options.verificationTrials > 0; ++i) {
+        const GemmGroup& group = groups[i];
+        if (group.m == 0) {
+            continue;
+        }
+        GemmShape groupShape = { group.m, group.n, group.k };
+        std::vector<uint8_t> columnMajorA;
+        std::vector<uint8_t> columnMajorB;
+        std::vector<uint8_t> columnMajorC;
+        const GemmKernelConfig& kernelConfig = gemmKernel.GetConfig();
+        result.verified = result.verified && VerifyGemmFreivalds(property, groupShape,
+            GetColumnMajor(kernelConfig.layoutA, inputData1.data() + static_cast<uint64_t>(group.offsetA) * aSize,
+                group.m, group.k, 1, aSize, columnMajorA),
+            GetColumnMajor(kernelConfig.layoutB, inputData2.data() + static_cast<uint64_t>(group.offsetB) * bSize,
+                group.k, group.n, 1, bSize, columnMajorB),
+            GetColumnMajor(kernelConfig.layoutC, readbackBytes + static_cast<uint64_t>(group.offsetC) * cSize,
+                group.m, group.n, 1, cSize, columnMajorC),
+            options.verificationTrials, options.seed + 2 + i);
+    }
+    return result;
+}
+
+BenchmarkResult RunCpuGemmBenchmark(const CpuGemm& cpuGemm, const GemmShape& shape, const BenchmarkOptions& options) {
+    const VkCooperativeMatrixPropertiesKHR& property = cpuGemm.GetProperty();
+    BenchmarkResult result;
+    result.type = GetCooperativeMatrixTypeName(property);
+    result.tile = std::to_string(cpuGemm.GetMicroTileM()) + "x" + std::to_string(cpuGemm.GetMicroTileN());
+    result.kernel = std::string("cpu-") + GetCpuGemmIsaName(cpuGemm.GetIsa());
+    result.shape = shape;
+    result.name = result.type + "/" + result.tile + "/" + GetShapeName(shape) + "/" + result.kernel;
+    result.repetitions = options.repetitions;
+    result.gpuTimestamps = false;
+
+    uint64_t countA = static_cast<uint64_t>(shape.m) * shape.k * shape.batch;
+    uint64_t countB = static_cast<uint64_t>(shape.k) * shape.n * shape.batch;
+    uint64_t sizeA = countA * GetComponentTypeSize(property.AType);
+    uint64_t sizeB = countB * GetComponentTypeSize(property.BType);
+    uint64_t sizeC = static_cast<uint64_t>(shape.m) * shape.n * shape.batch * GetComponentTypeSize(property.ResultType);
+    result.kernelBytes = sizeA + sizeB + sizeC;
+    std::vector<uint8_t> a(sizeA);
+    std::vector<uint8_t> b(sizeB);
+    std::vector<uint8_t> c(sizeC);
+    FillRandomComponents(a.data(), property.AType, countA, options.seed);
+    FillRandomComponents(b.data(), property.BType, countB, options.seed + 1);
+
+    for (uint32_t i = 0; i < options.warmupIterations; ++i) {
+        cpuGemm.Run(shape, a.data(), b.data(), c.data());
+    }
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < options.repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        cpuGemm.Run(shape, a.data(), b.data(), c.data());
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    result.kernelNanoseconds = ComputeStatistics(samples);
+
+    result.verified = options.verificationTrials == 0 ||
+        VerifyGemmFreivalds(property, shape, a.data(), b.data(), c.data(), options.verificationTrials,
+            options.seed + 2);
+    return result;
+}
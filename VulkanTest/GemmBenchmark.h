@@ -0,0 +1,25 @@
+#pragma once
+
+#ifndef GEMM_BENCHMARK_H_
+#define GEMM_BENCHMARK_H_
+
+#include "Benchmark.h"
+#include "CpuGemm.h"
+#include "GemmKernel.h"
+
+// Uploads inputs for one shape, runs options.warmupIterations unmeasured and options.repetitions
+// measured dispatches of gemmKernel, then reads the result back and verifies it.
+BenchmarkResult RunGemmBenchmark(
+    VulkanRuntime& vulkanRuntime, GemmKernel& gemmKernel, const GemmShape& shape,
+    const BenchmarkOptions& options);
+
+// Runs options.groupCount GEMMs of N x K with random M that average shape.m as one grouped dispatch of a
+// grouped gemmKernel. The group table is uploaded once and turned into the indirect dispatch on the GPU.
+BenchmarkResult RunGroupedGemmBenchmark(
+    VulkanRuntime& vulkanRuntime, GemmKernel& gemmKernel, const GemmShape& shape,
+    const BenchmarkOptions& options);
+
+// The same measurement for the CPU backend, timed with the host clock around every Run().
+BenchmarkResult RunCpuGemmBenchmark(const CpuGemm& cpuGemm, const GemmShape& shape, const BenchmarkOptions& options);
+
+#endif
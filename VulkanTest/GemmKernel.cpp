@@ -0,0 +1,919 @@
+#include "GemmKernel.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+    struct GemmPushConstants {
+        uint32_t m;
+        uint32_t n;
+        uint32_t k;
+        uint32_t strideA;
+        uint32_t strideB;
+        uint32_t strideC;
+        uint32_t groupCount;
+        uint32_t splitK;
+        int32_t zeroPointA;
+        int32_t zeroPointB;
+        float scale;
+        float clampMin;
+        float clampMax;
+    };
+
+    // The DEVICE_ADDRESS push constants: the 64-bit addresses follow the problem, 8-byte aligned. The shader
+    // reads each one as a uvec2, which has the same layout on little-endian hosts.
+    struct DeviceAddressGemmPushConstants {
+        GemmPushConstants problem;
+        VkDeviceAddress a;
+        VkDeviceAddress b;
+        VkDeviceAddress c;
+        VkDeviceAddress bias;
+    };
+
+    struct GroupedProloguePushConstants {
+        uint32_t groupCount;
+        uint32_t blockM;
+        uint32_t blockN;
+    };
+
+    struct SplitKReducePushConstants {
+        uint32_t wordCount;
+        uint32_t strideC;
+        uint32_t splitK;
+    };
+
+    struct PackTilesPushConstants {
+        uint32_t rows;
+        uint32_t columns;
+        uint32_t tileRows;
+        uint32_t tileColumns;
+        uint32_t batchStride;
+        uint32_t operandB;
+    };
+
+    struct QuantizationSumsPushConstants {
+        uint32_t m;
+        uint32_t n;
+        uint32_t k;
+        uint32_t strideA;
+        uint32_t strideB;
+    };
+
+    // compute_nv.comp uses bindings 0 to 3 and 5 to 9; grouped_prologue.comp uses 3 and 4, splitk_reduce.comp 2
+    // and 5, quantized_sums.comp 0, 1 and 7, pack_tiles.comp 0, 1, 10 and 11.
+    constexpr uint32_t kGroupTableBinding = 3;
+    constexpr uint32_t kSplitKWorkspaceBinding = 5;
+    constexpr uint32_t kBiasBinding = 6;
+    constexpr uint32_t kQuantizationSumsBinding = 7;
+    constexpr uint32_t kZeroPointsBBinding = 8;
+    constexpr uint32_t kWeightScalesBinding = 9;
+    constexpr uint32_t kUnpackedABinding = 10;
+    constexpr uint32_t kBindingCount = 12;
+
+    // Invocations per workgroup of splitk_reduce.comp, quantized_sums.comp and pack_tiles.comp.
+    constexpr uint32_t kSplitKReduceWorkgroupSize = 256;
+    constexpr uint32_t kQuantizationSumsWorkgroupSize = 64;
+    constexpr uint32_t kPackTilesWorkgroupSize = 256;
+    // Split-K heuristic: workgroups per compute unit to aim for, the compute unit count to assume when the
+    // device does not report one, the shallowest partition worth its partial result, and the most partitions.
+    constexpr uint32_t kSplitKWorkgroupsPerComputeUnit = 2;
+    constexpr uint32_t kDefaultComputeUnitCount = 32;
+    constexpr uint32_t kMinSplitKDepth = 256;
+    constexpr uint32_t kMaxSplitK = 64;
+
+    // Shader variants built from compute_nv.comp, see vulkan_test_add_gemm_shader() in CMakeLists.txt.
+    const char* const kGemmShaderVariants[] = {
+        "f16_f16_f16_f16",
+        "f16_f16_f32_f32",
+        "s8_s8_s32_s32",
+        "s8_u8_s32_s32",
+        "u8_s8_s32_s32",
+        "u8_u8_u32_u32",
+        "s8_s8_s32_s32_sat",
+        "u8_u8_u32_u32_sat",
+    };
+
+    uint32_t DivideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+
+    GemmPushConstants MakePushConstants(
+        const GemmShape& shape, const GemmBatchStrides& strides, uint32_t groupCount, uint32_t splitK,
+        const GemmEpilogueParameters& epilogueParameters) {
+        return {
+            shape.m, shape.n, shape.k, strides.a, strides.b, strides.c, groupCount, splitK,
+            epilogueParameters.zeroPointA, epilogueParameters.zeroPointB, epilogueParameters.scale,
+            epilogueParameters.clampMin, epilogueParameters.clampMax };
+    }
+}  // anonymous namespace
+
+GemmBatchStrides GetPackedBatchStrides(const GemmShape& shape) {
+    GemmBatchStrides strides;
+    strides.a = shape.m * shape.k;
+    strides.b = shape.k * shape.n;
+    strides.c = shape.m * shape.n;
+    return strides;
+}
+
+void PackOperandTiles(
+    ThreadPool& threadPool, const VkCooperativeMatrixPropertiesKHR& property, GemmOperand operand,
+    const GemmShape& shape, const void* source, void* packed) {
+    const bool operandB = operand == GemmOperand::B;
+    const uint32_t elementSize = GetComponentTypeSize(operandB ? property.BType : property.AType);
+    const uint32_t rows = operandB ? shape.k : shape.m;
+    const uint32_t columns = operandB ? shape.n : shape.k;
+    const uint32_t tileRows = operandB ? property.KSize : property.MSize;
+    const uint32_t tileColumns = operandB ? property.NSize : property.KSize;
+    assert(rows % tileRows == 0 && columns % tileColumns == 0);
+    // The tiles of one row of A or one column of B are consecutive, so each task fills a contiguous range.
+    const uint32_t outerTiles = operandB ? columns / tileColumns : rows / tileRows;
+    const uint32_t innerTiles = operandB ? rows / tileRows : columns / tileColumns;
+    const size_t columnBytes = static_cast<size_t>(tileRows) * elementSize;
+    const size_t tileBytes = columnBytes * tileColumns;
+    const size_t entryBytes = static_cast<size_t>(rows) * columns * elementSize;
+    threadPool.ParallelFor(outerTiles * shape.batch, [&](uint32_t index) {
+        const uint8_t* sourceEntry = static_cast<const uint8_t*>(source) + (index / outerTiles) * entryBytes;
+        uint8_t* destination = static_cast<uint8_t*>(packed) + (index / outerTiles) * entryBytes +
+            (index % outerTiles) * innerTiles * tileBytes;
+        for (uint32_t inner = 0; inner < innerTiles; ++inner) {
+            const uint32_t tileRow = operandB ? inner : index % outerTiles;
+            const uint32_t tileColumn = operandB ? index % outerTiles : inner;
+            for (uint32_t column = 0; column < tileColumns; ++column) {
+                const size_t sourceColumn = static_cast<size_t>(tileColumn) * tileColumns + column;
+                memcpy(destination, sourceEntry + sourceColumn * rows * elementSize + tileRow * columnBytes,
+                    columnBytes);
+                destination += columnBytes;
+            }
+        }
+    });
+}
+
+void PackInt4Weights(const int8_t* weights, uint32_t k, uint32_t n, uint8_t* packed) {
+    assert(k % 2 == 0);
+    // Row j of the weights is column j of B, so the order of the elements does not change.
+    for (uint64_t i = 0; i < static_cast<uint64_t>(k) * n; i += 2) {
+        assert(weights[i] >= -8 && weights[i] <= 7 && weights[i + 1] >= -8 && weights[i + 1] <= 7);
+        packed[i / 2] = static_cast<uint8_t>((weights[i] & 0xF) | ((weights[i + 1] & 0xF) << 4));
+    }
+}
+
+bool IsEpilogueEmpty(const GemmEpilogue& epilogue) {
+    return epilogue.zeroPoints == GemmZeroPoints::None && !epilogue.bias &&
+        epilogue.activation == GemmActivation::None && epilogue.outputType == GemmOutputType::Accumulator;
+}
+
+GemmKernel::GemmKernel(
+    VulkanRuntime& vulkanRuntime,
+    const VkCooperativeMatrixPropertiesKHR& property,
+    const GemmKernelConfig& config)
+    : mDevice(vulkanRuntime.GetLogicalDevice()),
+      mProperty(property),
+      mConfig(config),
+      mLimits(vulkanRuntime.GetPhysicalDeviceProperties().limits),
+      mComputeUnitCount(vulkanRuntime.GetComputeUnitCount()),
+      mPlaceholderBuffer(vulkanRuntime.CreateBuffer(
+          sizeof(GemmGroup), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+    assert(!(mConfig.grouped && mConfig.deviceAddress));
+    assert(!(mConfig.splitK && (mConfig.grouped || mConfig.deviceAddress)));
+    assert(!(mConfig.splitK && HasEpilogue()));
+    assert(IsEpilogueSupported(mProperty, mConfig.epilogue));
+    assert(!(mConfig.epilogue.zeroPoints != GemmZeroPoints::None && (mConfig.grouped || mConfig.deviceAddress)));
+    assert(!(mConfig.packedOperands && (mConfig.grouped || mConfig.int4GroupSize != 0 ||
+        mConfig.epilogue.zeroPoints != GemmZeroPoints::None)));
+    assert(mConfig.int4GroupSize == 0 || (mConfig.stageInShared && !mConfig.grouped && !mConfig.deviceAddress &&
+        IsInt4WeightsSupported(mProperty, mConfig.int4GroupSize)));
+    assert(!(mConfig.packedOperands &&
+        (mConfig.layoutA != GemmLayout::ColumnMajor || mConfig.layoutB != GemmLayout::ColumnMajor)));
+    assert(!(mConfig.int4GroupSize != 0 && mConfig.layoutB != GemmLayout::ColumnMajor));
+    if (!mConfig.deviceAddress) {
+        CreateDescriptorSets(vulkanRuntime.SupportsDescriptorUpdateAfterBind());
+    }
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size =
+        mConfig.deviceAddress ? sizeof(DeviceAddressGemmPushConstants) : sizeof(GemmPushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = mConfig.deviceAddress ? 0 : 1;
+    pipelineLayoutCreateInfo.pSetLayouts = mConfig.deviceAddress ? nullptr : &mDescriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(mDevice, &pipelineLayoutCreateInfo, nullptr, &mPipelineLayout));
+
+    // Pin the subgroup size so that gl_NumSubgroups matches SUBGROUPS_M * SUBGROUPS_N.
+    const VkPhysicalDeviceVulkan13Properties& vulkan13Properties = vulkanRuntime.GetVulkan13Properties();
+    uint32_t subgroupSize = vulkanRuntime.GetVulkan11Properties().subgroupSize;
+    bool requireSubgroupSize =
+        (vulkan13Properties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0;
+    if (!requireSubgroupSize) {
+        subgroupSize = std::max(subgroupSize, vulkan13Properties.maxSubgroupSize);
+    }
+    uint32_t workgroupSize = subgroupSize * mConfig.subgroupsM * mConfig.subgroupsN;
+    assert(workgroupSize <= mLimits.maxComputeWorkGroupInvocations);
+
+    mPipelineRequest.shaderPath = "Shaders/compute_nv_" + GetShaderVariantName(mProperty) +
+        (mConfig.deviceAddress ? "_bda" : "") + ".comp.spv";
+    mPipelineRequest.specializationConstants = {
+        mProperty.MSize, mProperty.NSize, mProperty.KSize, workgroupSize,
+        mConfig.subgroupsM, mConfig.subgroupsN, mConfig.tilesM, mConfig.tilesN,
+        mConfig.stageInShared ? VK_TRUE : VK_FALSE, mConfig.grouped ? VK_TRUE : VK_FALSE,
+        mConfig.epilogue.bias ? VK_TRUE : VK_FALSE, static_cast<uint32_t>(mConfig.epilogue.activation),
+        static_cast<uint32_t>(mConfig.epilogue.outputType), static_cast<uint32_t>(mConfig.epilogue.zeroPoints),
+        mConfig.int4GroupSize, mConfig.packedOperands ? VK_TRUE : VK_FALSE,
+        mConfig.layoutA == GemmLayout::RowMajor ? VK_TRUE : VK_FALSE,
+        mConfig.layoutB == GemmLayout::RowMajor ? VK_TRUE : VK_FALSE,
+        mConfig.layoutC == GemmLayout::RowMajor ? VK_TRUE : VK_FALSE,
+    };
+    mPipelineRequest.layout = mPipelineLayout;
+    mPipelineRequest.stageFlags = VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT;
+    mPipelineRequest.requiredSubgroupSize = requireSubgroupSize ? subgroupSize : 0;
+
+    if (mConfig.grouped) {
+        mProloguePipelineRequest.shaderPath = "Shaders/grouped_prologue.comp.spv";
+        mProloguePipelineRequest.layout = mPipelineLayout;
+    }
+    if (mConfig.splitK) {
+        uint32_t accumulatorType = 0;
+        if (mProperty.ResultType == VK_COMPONENT_TYPE_FLOAT32_KHR) {
+            accumulatorType = 1;
+        } else if (mProperty.ResultType == VK_COMPONENT_TYPE_FLOAT16_KHR) {
+            accumulatorType = 2;
+        }
+        mReducePipelineRequest.shaderPath = "Shaders/splitk_reduce.comp.spv";
+        mReducePipelineRequest.specializationConstants = { accumulatorType };
+        mReducePipelineRequest.layout = mPipelineLayout;
+    }
+    if (mConfig.epilogue.zeroPoints != GemmZeroPoints::None) {
+        mSumsPipelineRequest.shaderPath = "Shaders/quantized_sums.comp.spv";
+        mSumsPipelineRequest.specializationConstants = {
+            mProperty.AType == VK_COMPONENT_TYPE_SINT8_KHR ? VK_TRUE : VK_FALSE,
+            mProperty.BType == VK_COMPONENT_TYPE_SINT8_KHR ? VK_TRUE : VK_FALSE,
+            mConfig.layoutA == GemmLayout::RowMajor ? VK_TRUE : VK_FALSE,
+            mConfig.layoutB == GemmLayout::RowMajor ? VK_TRUE : VK_FALSE,
+        };
+        mSumsPipelineRequest.layout = mPipelineLayout;
+    }
+    if (mConfig.packedOperands && !mConfig.deviceAddress) {
+        mPackPipelineRequest.shaderPath = "Shaders/pack_tiles.comp.spv";
+        mPackPipelineRequest.layout = mPipelineLayout;
+    }
+}
+
+GemmKernel::~GemmKernel() {
+    if (mPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mPipeline, nullptr);
+    }
+    if (mProloguePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mProloguePipeline, nullptr);
+    }
+    if (mReducePipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mReducePipeline, nullptr);
+    }
+    if (mSumsPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mSumsPipeline, nullptr);
+    }
+    if (mPackPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mPackPipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    if (mDescriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+    }
+}
+
+// With update-after-bind, BindBuffers() does not invalidate command buffers that were recorded earlier.
+void GemmKernel::CreateDescriptorSets(bool updateAfterBind) {
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    poolCreateInfo.maxSets = kDescriptorSetCount;
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = kBindingCount * kDescriptorSetCount;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(mDevice, &poolCreateInfo, nullptr, &mDescriptorPool));
+
+    std::array<VkDescriptorSetLayoutBinding, kBindingCount> bindingDescs = {};
+    for (uint32_t i = 0; i < kBindingCount; ++i) {
+        bindingDescs[i].binding = i;
+        bindingDescs[i].descriptorCount = 1;
+        bindingDescs[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindingDescs[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    std::array<VkDescriptorBindingFlags, kBindingCount> bindingFlags = {};
+    bindingFlags.fill(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
+    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    if (updateAfterBind) {
+        descriptorSetLayoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+        descriptorSetLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+    descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindingDescs.size());
+    descriptorSetLayoutCreateInfo.pBindings = bindingDescs.data();
+    VK_CHECK_RESULT(
+        vkCreateDescriptorSetLayout(mDevice, &descriptorSetLayoutCreateInfo, nullptr, &mDescriptorSetLayout));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.descriptorPool = mDescriptorPool;
+    std::array<VkDescriptorSetLayout, kDescriptorSetCount> descriptorSetLayouts;
+    descriptorSetLayouts.fill(mDescriptorSetLayout);
+    descriptorSetAllocateInfo.descriptorSetCount = kDescriptorSetCount;
+    descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(mDevice, &descriptorSetAllocateInfo, mDescriptorSets.data()));
+    for (uint32_t i = 0; i < kDescriptorSetCount; ++i) {
+        WriteStorageBuffers(i, kGroupTableBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(i, kSplitKWorkspaceBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(i, kBiasBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(i, kQuantizationSumsBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(i, kZeroPointsBBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(i, kWeightScalesBinding, { mPlaceholderBuffer.GetVkBuffer() });
+        WriteStorageBuffers(
+            i, kUnpackedABinding, { mPlaceholderBuffer.GetVkBuffer(), mPlaceholderBuffer.GetVkBuffer() });
+    }
+}
+
+void GemmKernel::CreatePipelines(PipelineRegistry& registry, const std::vector<GemmKernel*>& gemmKernels) {
+    std::vector<PipelineRequest> requests;
+    for (const GemmKernel* gemmKernel : gemmKernels) {
+        assert(gemmKernel->mPipeline == VK_NULL_HANDLE);
+        requests.push_back(gemmKernel->mPipelineRequest);
+    }
+    // Prologue, reduction, quantization sums and packing pipelines follow the GEMM pipelines, in the order of
+    // their kernels.
+    for (const GemmKernel* gemmKernel : gemmKernels) {
+        if (gemmKernel->mConfig.grouped) {
+            requests.push_back(gemmKernel->mProloguePipelineRequest);
+        }
+        if (gemmKernel->mConfig.splitK) {
+            requests.push_back(gemmKernel->mReducePipelineRequest);
+        }
+        if (gemmKernel->mConfig.epilogue.zeroPoints != GemmZeroPoints::None) {
+            requests.push_back(gemmKernel->mSumsPipelineRequest);
+        }
+        if (gemmKernel->mConfig.packedOperands && !gemmKernel->mConfig.deviceAddress) {
+            requests.push_back(gemmKernel->mPackPipelineRequest);
+        }
+    }
+    std::vector<VkPipeline> pipelines = registry.CreatePipelines(requests);
+    size_t auxiliaryIndex = gemmKernels.size();
+    for (size_t i = 0; i < gemmKernels.size(); ++i) {
+        gemmKernels[i]->mPipeline = pipelines[i];
+    }
+    for (GemmKernel* gemmKernel : gemmKernels) {
+        if (gemmKernel->mConfig.grouped) {
+            gemmKernel->mProloguePipeline = pipelines[auxiliaryIndex++];
+        }
+        if (gemmKernel->mConfig.splitK) {
+            gemmKernel->mReducePipeline = pipelines[auxiliaryIndex++];
+        }
+        if (gemmKernel->mConfig.epilogue.zeroPoints != GemmZeroPoints::None) {
+            gemmKernel->mSumsPipeline = pipelines[auxiliaryIndex++];
+        }
+        if (gemmKernel->mConfig.packedOperands && !gemmKernel->mConfig.deviceAddress) {
+            gemmKernel->mPackPipeline = pipelines[auxiliaryIndex++];
+        }
+    }
+}
+
+bool GemmKernel::IsPropertySupported(const VkCooperativeMatrixPropertiesKHR& property) {
+    if (property.scope != VK_SCOPE_SUBGROUP_KHR) {
+        return false;
+    }
+    std::string variantName = GetShaderVariantName(property);
+    for (const char* variant : kGemmShaderVariants) {
+        if (variantName == variant) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string GemmKernel::GetShaderVariantName(const VkCooperativeMatrixPropertiesKHR& property) {
+    std::string name = GetCooperativeMatrixTypeName(property);
+    if (property.saturatingAccumulation) {
+        name += "_sat";
+    }
+    return name;
+}
+
+bool GemmKernel::IsEpilogueSupported(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmEpilogue& epilogue) {
+    return IsEpilogueEmpty(epilogue) || !IsFloatComponentType(property.ResultType);
+}
+
+bool GemmKernel::IsInt4WeightsSupported(const VkCooperativeMatrixPropertiesKHR& property, uint32_t groupSize) {
+    return property.BType == VK_COMPONENT_TYPE_FLOAT16_KHR && groupSize != 0 && groupSize % 8 == 0;
+}
+
+const VkCooperativeMatrixPropertiesKHR& GemmKernel::GetProperty() const {
+    return mProperty;
+}
+
+const GemmKernelConfig& GemmKernel::GetConfig() const {
+    return mConfig;
+}
+
+std::string GemmKernel::GetKernelName() const {
+    return GetKernelName(mConfig);
+}
+
+std::string GemmKernel::GetKernelName(const GemmKernelConfig& config) {
+    std::string name = config.stageInShared ? "shared" : "direct";
+    // One letter per operand, A, B then C: c for column major and r for row major.
+    if (config.layoutA != GemmLayout::ColumnMajor || config.layoutB != GemmLayout::ColumnMajor ||
+        config.layoutC != GemmLayout::ColumnMajor) {
+        name += "_";
+        for (GemmLayout layout : { config.layoutA, config.layoutB, config.layoutC }) {
+            name += layout == GemmLayout::RowMajor ? 'r' : 'c';
+        }
+    }
+    if (config.packedOperands) {
+        name += "_packed";
+    }
+    if (config.int4GroupSize != 0) {
+        name += "_w4g" + std::to_string(config.int4GroupSize);
+    }
+    if (config.deviceAddress) {
+        name += "_bda";
+    }
+    if (config.epilogue.zeroPoints == GemmZeroPoints::PerTensor) {
+        name += "_zp";
+    } else if (config.epilogue.zeroPoints == GemmZeroPoints::PerColumn) {
+        name += "_zpcol";
+    }
+    if (config.epilogue.bias) {
+        name += "_bias";
+    }
+    if (config.epilogue.activation == GemmActivation::Relu) {
+        name += "_relu";
+    } else if (config.epilogue.activation == GemmActivation::Clamp) {
+        name += "_clamp";
+    }
+    if (config.epilogue.outputType == GemmOutputType::Uint8) {
+        name += "_u8";
+    } else if (config.epilogue.outputType == GemmOutputType::Sint8) {
+        name += "_s8";
+    }
+    return name;
+}
+
+bool GemmKernel::HasEpilogue() const {
+    return !IsEpilogueEmpty(mConfig.epilogue);
+}
+
+VkComponentTypeKHR GemmKernel::GetOutputComponentType() const {
+    if (mConfig.epilogue.outputType == GemmOutputType::Uint8) {
+        return VK_COMPONENT_TYPE_UINT8_KHR;
+    }
+    if (mConfig.epilogue.outputType == GemmOutputType::Sint8) {
+        return VK_COMPONENT_TYPE_SINT8_KHR;
+    }
+    return mProperty.ResultType;
+}
+
+uint32_t GemmKernel::GetBlockM() const {
+    return mConfig.subgroupsM * mConfig.tilesM * mProperty.MSize;
+}
+
+uint32_t GemmKernel::GetBlockN() const {
+    return mConfig.subgroupsN * mConfig.tilesN * mProperty.NSize;
+}
+
+uint32_t GemmKernel::GetSharedMemorySize() const {
+    // Mirrors the shared arrays declared in compute_nv.comp: one result tile per subgroup for the epilogue,
+    // and the double-buffered slices, whose columns or rows are padded by a uvec4.
+    uint32_t size = 0;
+    if (HasEpilogue()) {
+        size += mConfig.subgroupsM * mConfig.subgroupsN * mProperty.MSize * mProperty.NSize *
+            GetComponentTypeSize(mProperty.ResultType);
+    }
+    if (mConfig.stageInShared) {
+        bool aRowMajor = mConfig.layoutA == GemmLayout::RowMajor;
+        bool bRowMajor = mConfig.layoutB == GemmLayout::RowMajor;
+        uint32_t aStride = (aRowMajor ? mProperty.KSize : GetBlockM()) * GetComponentTypeSize(mProperty.AType) + 16;
+        uint32_t bStride = (bRowMajor ? GetBlockN() : mProperty.KSize) * GetComponentTypeSize(mProperty.BType) + 16;
+        size += 2 * (aStride * (aRowMajor ? GetBlockM() : mProperty.KSize) +
+            bStride * (bRowMajor ? mProperty.KSize : GetBlockN()));
+    }
+    return size;
+}
+
+bool GemmKernel::IsGroupedDispatchSupported(const std::vector<GemmGroup>& groups) const {
+    if (!mConfig.grouped || groups.empty()) {
+        return false;
+    }
+    uint64_t workgroupCount = 0;
+    for (const GemmGroup& group : groups) {
+        if (group.m == 0 || group.n == 0) {
+            continue;
+        }
+        GemmShape shape = { group.m, group.n, group.k };
+        if (!IsShapeSupported(shape)) {
+            return false;
+        }
+        GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+        workgroupCount += static_cast<uint64_t>(dispatchSize.x) * dispatchSize.y;
+    }
+    return workgroupCount <= mLimits.maxComputeWorkGroupCount[0];
+}
+
+bool GemmKernel::IsShapeSupported(const GemmShape& shape) const {
+    if (shape.m == 0 || shape.n == 0 || shape.k == 0 || shape.batch == 0) {
+        return false;
+    }
+    if (shape.m % mProperty.MSize != 0 || shape.n % mProperty.NSize != 0 || shape.k % mProperty.KSize != 0) {
+        return false;
+    }
+    if (mConfig.stageInShared) {
+        // Slices are copied to shared memory in 16-byte pieces, so every column, or row of a row-major operand,
+        // they read must be 16-byte aligned, and tiles are loaded from shared memory at word offsets.
+        uint32_t aSize = GetComponentTypeSize(mProperty.AType);
+        uint32_t bSize = GetComponentTypeSize(mProperty.BType);
+        if (mConfig.layoutA == GemmLayout::RowMajor) {
+            if ((mProperty.KSize * aSize) % 16 != 0 || (shape.k * aSize) % 16 != 0) {
+                return false;
+            }
+        } else if ((GetBlockM() * aSize) % 16 != 0 || (shape.m * aSize) % 16 != 0 ||
+            (mProperty.MSize * aSize) % 4 != 0) {
+            return false;
+        }
+        if (mConfig.layoutB == GemmLayout::RowMajor) {
+            if ((GetBlockN() * bSize) % 16 != 0 || (shape.n * bSize) % 16 != 0 ||
+                (mProperty.NSize * bSize) % 4 != 0) {
+                return false;
+            }
+        } else if ((mProperty.KSize * bSize) % 16 != 0 || (shape.k * bSize) % 16 != 0) {
+            return false;
+        }
+    }
+    if (GetSharedMemorySize() > mLimits.maxComputeSharedMemorySize) {
+        return false;
+    }
+    // Packed tiles are moved in 16-byte pieces of their columns, by staging and by pack_tiles.comp, which runs
+    // one invocation per piece of the larger operand and one workgroup row per batch entry.
+    if (mConfig.packedOperands) {
+        uint32_t aColumnBytes = mProperty.MSize * GetComponentTypeSize(mProperty.AType);
+        uint32_t bColumnBytes = mProperty.KSize * GetComponentTypeSize(mProperty.BType);
+        uint64_t pieceCount = std::max(
+            static_cast<uint64_t>(shape.m) * shape.k * GetComponentTypeSize(mProperty.AType),
+            static_cast<uint64_t>(shape.k) * shape.n * GetComponentTypeSize(mProperty.BType)) / 16;
+        if (aColumnBytes % 16 != 0 || bColumnBytes % 16 != 0 ||
+            (pieceCount + kPackTilesWorkgroupSize - 1) / kPackTilesWorkgroupSize >
+            mLimits.maxComputeWorkGroupCount[0] || shape.batch > mLimits.maxComputeWorkGroupCount[1]) {
+            return false;
+        }
+    }
+    // A scale group must not straddle two columns.
+    if (mConfig.int4GroupSize != 0 && shape.k % mConfig.int4GroupSize != 0) {
+        return false;
+    }
+    // quantized_sums.comp runs one workgroup per 64 rows of A and one per column of B.
+    if (mConfig.epilogue.zeroPoints != GemmZeroPoints::None &&
+        static_cast<uint64_t>(DivideRoundingUp(shape.m, kQuantizationSumsWorkgroupSize)) + shape.n >
+        mLimits.maxComputeWorkGroupCount[0]) {
+        return false;
+    }
+    GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+    return dispatchSize.x <= mLimits.maxComputeWorkGroupCount[0] &&
+        dispatchSize.y <= mLimits.maxComputeWorkGroupCount[1] &&
+        dispatchSize.z <= mLimits.maxComputeWorkGroupCount[2];
+}
+
+bool GemmKernel::IsSplitKSupported(const GemmShape& shape, uint32_t splitK) const {
+    if (splitK == 0 || !IsShapeSupported(shape)) {
+        return false;
+    }
+    if (splitK == 1) {
+        return true;
+    }
+    // Saturating each partial sum would clamp at different points than accumulating over all of K.
+    if (!mConfig.splitK || mProperty.saturatingAccumulation) {
+        return false;
+    }
+    if ((shape.k / mProperty.KSize) % splitK != 0 ||
+        static_cast<uint64_t>(shape.batch) * splitK > mLimits.maxComputeWorkGroupCount[2]) {
+        return false;
+    }
+    uint64_t wordCount = static_cast<uint64_t>(shape.m) * shape.n * GetComponentTypeSize(mProperty.ResultType) / 4;
+    return (wordCount + kSplitKReduceWorkgroupSize - 1) / kSplitKReduceWorkgroupSize <=
+        mLimits.maxComputeWorkGroupCount[0] &&
+        shape.batch <= mLimits.maxComputeWorkGroupCount[1];
+}
+
+uint32_t GemmKernel::GetSplitKFactor(const GemmShape& shape) const {
+    if (!mConfig.splitK || !IsShapeSupported(shape)) {
+        return 1;
+    }
+    GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+    uint64_t workgroupCount = static_cast<uint64_t>(dispatchSize.x) * dispatchSize.y * dispatchSize.z;
+    uint32_t computeUnitCount = mComputeUnitCount != 0 ? mComputeUnitCount : kDefaultComputeUnitCount;
+    uint64_t targetWorkgroupCount = static_cast<uint64_t>(computeUnitCount) * kSplitKWorkgroupsPerComputeUnit;
+    if (workgroupCount >= targetWorkgroupCount) {
+        return 1;
+    }
+    uint64_t maxSplitK = std::min<uint64_t>(
+        { (targetWorkgroupCount + workgroupCount - 1) / workgroupCount, shape.k / kMinSplitKDepth, kMaxSplitK });
+    for (uint32_t splitK = static_cast<uint32_t>(maxSplitK); splitK > 1; --splitK) {
+        if (IsSplitKSupported(shape, splitK)) {
+            return splitK;
+        }
+    }
+    return 1;
+}
+
+VkDeviceSize GemmKernel::GetSplitKWorkspaceSize(const GemmShape& shape, uint32_t splitK) const {
+    return static_cast<VkDeviceSize>(splitK) * shape.batch * shape.m * shape.n *
+        GetComponentTypeSize(mProperty.ResultType);
+}
+
+VkDeviceSize GemmKernel::GetQuantizationSumsSize(const GemmShape& shape) const {
+    return static_cast<VkDeviceSize>(shape.batch) * (shape.m + shape.n) * sizeof(int32_t);
+}
+
+GemmDispatchSize GemmKernel::GetDispatchSize(const GemmShape& shape) const {
+    GemmDispatchSize dispatchSize;
+    dispatchSize.x = DivideRoundingUp(shape.m, GetBlockM());
+    dispatchSize.y = DivideRoundingUp(shape.n, GetBlockN());
+    dispatchSize.z = shape.batch;
+    return dispatchSize;
+}
+
+void GemmKernel::BindBuffers(
+    const VulkanBuffer& a, const VulkanBuffer& b, const VulkanBuffer& c, uint32_t descriptorSet) {
+    assert(!mConfig.deviceAddress);
+    WriteStorageBuffers(descriptorSet, 0, { a.GetVkBuffer(), b.GetVkBuffer(), c.GetVkBuffer() });
+}
+
+void GemmKernel::BindBias(const VulkanBuffer& bias, uint32_t descriptorSet) {
+    assert(!mConfig.deviceAddress && mConfig.epilogue.bias);
+    WriteStorageBuffers(descriptorSet, kBiasBinding, { bias.GetVkBuffer() });
+}
+
+void GemmKernel::BindQuantizationSums(const VulkanBuffer& sums, uint32_t descriptorSet) {
+    assert(mConfig.epilogue.zeroPoints != GemmZeroPoints::None);
+    WriteStorageBuffers(descriptorSet, kQuantizationSumsBinding, { sums.GetVkBuffer() });
+}
+
+void GemmKernel::BindZeroPointsB(const VulkanBuffer& zeroPointsB, uint32_t descriptorSet) {
+    assert(mConfig.epilogue.zeroPoints == GemmZeroPoints::PerColumn);
+    WriteStorageBuffers(descriptorSet, kZeroPointsBBinding, { zeroPointsB.GetVkBuffer() });
+}
+
+void GemmKernel::BindUnpackedOperands(const VulkanBuffer& a, const VulkanBuffer& b, uint32_t descriptorSet) {
+    assert(mConfig.packedOperands && !mConfig.deviceAddress);
+    WriteStorageBuffers(descriptorSet, kUnpackedABinding, { a.GetVkBuffer(), b.GetVkBuffer() });
+}
+
+void GemmKernel::BindWeightScales(const VulkanBuffer& scales, uint32_t descriptorSet) {
+    assert(mConfig.int4GroupSize != 0);
+    WriteStorageBuffers(descriptorSet, kWeightScalesBinding, { scales.GetVkBuffer() });
+}
+
+void GemmKernel::SetEpilogueParameters(const GemmEpilogueParameters& parameters) {
+    mEpilogueParameters = parameters;
+}
+
+void GemmKernel::BindGroupTable(
+    const VulkanBuffer& groupTable, const VulkanBuffer& dispatchArguments, uint32_t descriptorSet) {
+    assert(mConfig.grouped);
+    WriteStorageBuffers(
+        descriptorSet, kGroupTableBinding, { groupTable.GetVkBuffer(), dispatchArguments.GetVkBuffer() });
+    mDispatchArgumentBuffers[descriptorSet] = dispatchArguments.GetVkBuffer();
+}
+
+void GemmKernel::BindSplitKWorkspace(const VulkanBuffer& workspace, uint32_t descriptorSet) {
+    assert(mConfig.splitK);
+    WriteStorageBuffers(descriptorSet, kSplitKWorkspaceBinding, { workspace.GetVkBuffer() });
+}
+
+void GemmKernel::WriteStorageBuffers(
+    uint32_t descriptorSet, uint32_t firstBinding, const std::vector<VkBuffer>& buffers) {
+    assert(descriptorSet < kDescriptorSetCount);
+    std::vector<VkDescriptorBufferInfo> bufferInfos(buffers.size());
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets(buffers.size());
+    for (uint32_t i = 0; i < buffers.size(); ++i) {
+        bufferInfos[i].buffer = buffers[i];
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+        writeDescriptorSets[i] = {};
+        writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[i].dstSet = mDescriptorSets[descriptorSet];
+        writeDescriptorSets[i].dstBinding = firstBinding + i;
+        writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[i].descriptorCount = 1;
+        writeDescriptorSets[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(
+        mDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(),
+        0, nullptr);
+}
+
+void GemmKernel::RecordDispatch(VkCommandBuffer commandBuffer, const GemmShape& shape, uint32_t descriptorSet) const {
+    RecordDispatch(commandBuffer, shape, GetPackedBatchStrides(shape), descriptorSet);
+}
+
+void GemmKernel::RecordDispatch(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides,
+    uint32_t descriptorSet) const {
+    assert(!mConfig.deviceAddress);
+    assert(descriptorSet < kDescriptorSetCount);
+    AssertDispatchSupported(shape, strides);
+    GemmPushConstants pushConstants = MakePushConstants(shape, strides, 0, 1, mEpilogueParameters);
+    GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSets[descriptorSet], 0,
+        nullptr);
+    if (mSumsPipeline != VK_NULL_HANDLE) {
+        RecordQuantizationSums(commandBuffer, shape, strides);
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, dispatchSize.x, dispatchSize.y, dispatchSize.z);
+}
+
+void GemmKernel::RecordDispatch(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBufferAddresses& addresses) const {
+    RecordDispatch(commandBuffer, shape, GetPackedBatchStrides(shape), addresses);
+}
+
+void GemmKernel::RecordDispatch(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides,
+    const GemmBufferAddresses& addresses) const {
+    assert(mConfig.deviceAddress);
+    assert(addresses.a % 16 == 0 && addresses.b % 16 == 0 && addresses.c % 16 == 0 && addresses.bias % 16 == 0);
+    AssertDispatchSupported(shape, strides);
+    DeviceAddressGemmPushConstants pushConstants = {};
+    pushConstants.problem = MakePushConstants(shape, strides, 0, 1, mEpilogueParameters);
+    pushConstants.a = addresses.a;
+    pushConstants.b = addresses.b;
+    pushConstants.c = addresses.c;
+    pushConstants.bias = addresses.bias;
+    GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, dispatchSize.x, dispatchSize.y, dispatchSize.z);
+}
+
+void GemmKernel::RecordSplitKDispatch(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, uint32_t splitK, uint32_t descriptorSet) const {
+    assert(mReducePipeline != VK_NULL_HANDLE);
+    assert(descriptorSet < kDescriptorSetCount);
+    assert(splitK > 1 && IsSplitKSupported(shape, splitK));
+    GemmBatchStrides strides = GetPackedBatchStrides(shape);
+    AssertDispatchSupported(shape, strides);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSets[descriptorSet], 0,
+        nullptr);
+
+    // The reduction of an earlier split-K dispatch may still be reading the partial results.
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+        0, nullptr, 0, nullptr);
+    GemmPushConstants pushConstants = MakePushConstants(shape, strides, 0, splitK, mEpilogueParameters);
+    GemmDispatchSize dispatchSize = GetDispatchSize(shape);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, dispatchSize.x, dispatchSize.y, dispatchSize.z * splitK);
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+        &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    uint32_t resultSize = GetComponentTypeSize(mProperty.ResultType);
+    SplitKReducePushConstants reducePushConstants = {
+        shape.m * shape.n * resultSize / 4, strides.c * resultSize / 4, splitK };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mReducePipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(reducePushConstants),
+        &reducePushConstants);
+    vkCmdDispatch(
+        commandBuffer, DivideRoundingUp(reducePushConstants.wordCount, kSplitKReduceWorkgroupSize), shape.batch, 1);
+}
+
+void GemmKernel::AssertDispatchSupported(const GemmShape& shape, const GemmBatchStrides& strides) const {
+    assert(mPipeline != VK_NULL_HANDLE);
+    assert(!mConfig.grouped);
+    assert(IsShapeSupported(shape));
+    // Shared memory staging reads 16-byte pieces, so every batch entry has to start 16-byte aligned.
+    assert(!mConfig.stageInShared || ((strides.a * GetComponentTypeSize(mProperty.AType)) % 16 == 0 &&
+        (strides.b * GetComponentTypeSize(mProperty.BType)) % 16 == 0));
+    // Every batch entry of packed B starts a new scale group.
+    assert(mConfig.int4GroupSize == 0 || strides.b % mConfig.int4GroupSize == 0);
+}
+
+// Expects the descriptor set of the dispatch to be bound.
+void GemmKernel::RecordQuantizationSums(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides) const {
+    // An earlier dispatch may still be reading the sums.
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+        0, nullptr, 0, nullptr);
+    QuantizationSumsPushConstants sumsPushConstants = { shape.m, shape.n, shape.k, strides.a, strides.b };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mSumsPipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sumsPushConstants),
+        &sumsPushConstants);
+    vkCmdDispatch(
+        commandBuffer, DivideRoundingUp(shape.m, kQuantizationSumsWorkgroupSize) + shape.n, 1, shape.batch);
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+        &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GemmKernel::RecordPackOperands(
+    VkCommandBuffer commandBuffer, const GemmShape& shape, bool packA, bool packB, uint32_t descriptorSet) const {
+    assert(mPackPipeline != VK_NULL_HANDLE);
+    assert(descriptorSet < kDescriptorSetCount);
+    assert(IsShapeSupported(shape));
+    // Earlier dispatches may still be reading the packed operands.
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+        0, nullptr, 0, nullptr);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPackPipeline);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSets[descriptorSet], 0,
+        nullptr);
+    uint32_t aSize = GetComponentTypeSize(mProperty.AType);
+    uint32_t bSize = GetComponentTypeSize(mProperty.BType);
+    std::vector<PackTilesPushConstants> passes;
+    if (packA) {
+        passes.push_back({ shape.m * aSize / 16, shape.k, mProperty.MSize * aSize / 16, mProperty.KSize,
+            shape.m * shape.k * aSize / 16, 0 });
+    }
+    if (packB) {
+        passes.push_back({ shape.k * bSize / 16, shape.n, mProperty.KSize * bSize / 16, mProperty.NSize,
+            shape.k * shape.n * bSize / 16, 1 });
+    }
+    for (const PackTilesPushConstants& pushConstants : passes) {
+        vkCmdPushConstants(
+            commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(
+            commandBuffer, DivideRoundingUp(pushConstants.batchStride, kPackTilesWorkgroupSize), shape.batch, 1);
+    }
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+        &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GemmKernel::RecordGroupedDispatch(VkCommandBuffer commandBuffer, uint32_t groupCount, uint32_t descriptorSet) const {
+    assert(mProloguePipeline != VK_NULL_HANDLE);
+    assert(descriptorSet < kDescriptorSetCount && mDispatchArgumentBuffers[descriptorSet] != VK_NULL_HANDLE);
+    assert(groupCount > 0);
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1, &mDescriptorSets[descriptorSet], 0,
+        nullptr);
+
+    // The prologue rewrites the group table and the dispatch arguments, which an earlier grouped dispatch
+    // may still be reading.
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+    GroupedProloguePushConstants prologuePushConstants = { groupCount, GetBlockM(), GetBlockN() };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mProloguePipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(prologuePushConstants),
+        &prologuePushConstants);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0,
+        nullptr, 0, nullptr);
+
+    GemmPushConstants pushConstants = MakePushConstants({}, {}, groupCount, 1, mEpilogueParameters);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdPushConstants(
+        commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatchIndirect(commandBuffer, mDispatchArgumentBuffers[descriptorSet], 0);
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#ifndef GEMM_KERNEL_H_
+#define GEMM_KERNEL_H_
+
+#include <array>
+
+#include "PipelineRegistry.h"
+#include "VulkanHelper.h"
+
+struct GemmShape {
+    uint32_t m = 0;
+    uint32_t n = 0;
+    uint32_t k = 0;
+    // Independent GEMMs of this size run by one dispatch.
+    uint32_t batch = 1;
+};
+
+// Elements between consecutive batch entries of A, B and C. A stride of 0 shares one matrix across the batch.
+struct GemmBatchStrides {
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+};
+
+// Strides of batch entries stored back to back.
+GemmBatchStrides GetPackedBatchStrides(const GemmShape& shape);
+
+enum class GemmOperand {
+    A,
+    B,
+};
+
+// Storage order of an operand. The leading dimension is the row count for column major and the column count for
+// row major, so a transposed operand is the same matrix in the other order.
+enum class GemmLayout {
+    ColumnMajor,
+    RowMajor,
+};
+
+// Rearranges a column-major A (M x K) or B (K x N) into the layout of kernels with
+// GemmKernelConfig::packedOperands: contiguous, column-major MSize x KSize tiles of A, ordered row of tiles by
+// row of tiles, and KSize x NSize tiles of B, ordered column of tiles by column of tiles, so that the K loop
+// of a subgroup reads consecutive tiles. Batch entries stay back to back. Every tile column is one contiguous
+// copy; rows or columns of tiles are spread over the thread pool.
+void PackOperandTiles(
+    ThreadPool& threadPool, const VkCooperativeMatrixPropertiesKHR& property, GemmOperand operand,
+    const GemmShape& shape, const void* source, void* packed);
+
+// Packs N x K row-major int8 weights in [-8, 7], one output column per row, into the B layout of kernels with
+// GemmKernelConfig::int4GroupSize: K x N column major with two weights per byte, the even row in the low
+// nibble. K must be even; packed receives K * N / 2 bytes.
+void PackInt4Weights(const int8_t* weights, uint32_t k, uint32_t n, uint8_t* packed);
+
+enum class GemmZeroPoints {
+    None,
+    // One zero point for A and one for B, GemmEpilogueParameters::zeroPointA and zeroPointB.
+    PerTensor,
+    // zeroPointA for A and one zero point per column of B, see GemmKernel::BindZeroPointsB().
+    PerColumn,
+};
+
+enum class GemmActivation {
+    None,
+    Relu,
+    // Clamp to [GemmEpilogueParameters::clampMin, clampMax].
+    Clamp,
+};
+
+enum class GemmOutputType {
+    // The result type of the cooperative matrix configuration.
+    Accumulator,
+    Uint8,
+    Sint8,
+};
+
+// Work fused into the store of C, applied to every element in this order: subtract the zero points, add the
+// bias of its column, apply the activation, then either store it in the accumulator type or multiply it by the
+// scale in float, round to nearest even and saturate it to 8 bits. Integer accumulators only, see
+// GemmKernel::IsEpilogueSupported().
+struct GemmEpilogue {
+    // Asymmetric quantization: C becomes the sum of (A - zero point of A) * (B - zero point of B) over K,
+    // computed from A * B and the row sums of A and column sums of B. The result is signed from then on,
+    // even for u32 accumulators. Descriptor kernels only.
+    GemmZeroPoints zeroPoints = GemmZeroPoints::None;
+    // Per-column bias in the accumulator type, shared by all batch entries; additions wrap like the accumulators.
+    bool bias = false;
+    GemmActivation activation = GemmActivation::None;
+    GemmOutputType outputType = GemmOutputType::Accumulator;
+};
+
+// Whether the epilogue only stores the accumulators, as a default-constructed one does.
+bool IsEpilogueEmpty(const GemmEpilogue& epilogue);
+
+// Values of a GemmEpilogue that may change between dispatches; they go into the push constants.
+struct GemmEpilogueParameters {
+    int32_t zeroPointA = 0;
+    // Ignored with GemmZeroPoints::PerColumn.
+    int32_t zeroPointB = 0;
+    float scale = 1.0f;
+    // Converted to the accumulator type, truncating towards zero; must not be negative for unsigned accumulators.
+    float clampMin = 0.0f;
+    float clampMax = 0.0f;
+};
+
+// How one workgroup covers its output block, see the specialization constants in compute_nv.comp.
+struct GemmKernelConfig {
+    uint32_t subgroupsM = 2;
+    uint32_t subgroupsN = 2;
+    uint32_t tilesM = 2;
+    uint32_t tilesN = 2;
+    // Stage A and B through double-buffered shared memory instead of loading them straight from the buffers.
+    bool stageInShared = false;
+    // Map workgroups onto the groups of a group table, see RecordGroupedDispatch().
+    bool grouped = false;
+    // Take A, B and C as buffer device addresses in push constants instead of descriptors, so switching
+    // operands between dispatches costs no descriptor updates. Cannot be combined with grouped.
+    bool deviceAddress = false;
+    // Allow splitting K across the workgroups of a dispatch, see RecordSplitKDispatch(). Cannot be combined
+    // with grouped or deviceAddress.
+    bool splitK = false;
+    // Cannot be combined with splitK; zero points cannot be combined with grouped or deviceAddress either.
+    GemmEpilogue epilogue;
+    // Read B as signed 4-bit weights packed by PackInt4Weights(), with one float scale per int4GroupSize
+    // consecutive elements of B, see BindWeightScales(). The weights are unpacked to float16 while B is staged,
+    // so this needs stageInShared and IsInt4WeightsSupported(). 0 reads B unpacked. Cannot be combined with
+    // grouped or deviceAddress.
+    uint32_t int4GroupSize = 0;
+    // Read A and B in the tiled layout of PackOperandTiles(), which turns every tile load into one contiguous
+    // block. Static operands only have to be packed once, on the host or with RecordPackOperands(). Cannot be
+    // combined with grouped, int4GroupSize or zero points.
+    bool packedOperands = false;
+    // Storage order of A (M x K), B (K x N) and C (M x N). Row-major A or B cannot be combined with
+    // packedOperands, and row-major B cannot be combined with int4GroupSize either.
+    GemmLayout layoutA = GemmLayout::ColumnMajor;
+    GemmLayout layoutB = GemmLayout::ColumnMajor;
+    GemmLayout layoutC = GemmLayout::ColumnMajor;
+};
+
+// Operand addresses of a device address kernel, from VulkanBuffer::GetDeviceAddress() plus an optional byte
+// offset. All of them must be 16-byte aligned; bias is only read by kernels with an epilogue bias.
+struct GemmBufferAddresses {
+    VkDeviceAddress a = 0;
+    VkDeviceAddress b = 0;
+    VkDeviceAddress c = 0;
+    VkDeviceAddress bias = 0;
+};
+
+// One GEMM of a grouped dispatch, as stored in the group table. Offsets are in elements of A, B and C.
+// firstWorkgroup and workgroupCount are written by the grouped prologue shader. Every group has to satisfy
+// GemmKernel::IsShapeSupported(); groups with M or N of 0 are skipped. Keep in sync with compute_nv.comp.
+struct GemmGroup {
+    uint32_t m = 0;
+    uint32_t n = 0;
+    uint32_t k = 0;
+    uint32_t offsetA = 0;
+    uint32_t offsetB = 0;
+    uint32_t offsetC = 0;
+    uint32_t firstWorkgroup = 0;
+    uint32_t workgroupCount = 0;
+};
+
+struct GemmDispatchSize {
+    uint32_t x = 1;
+    uint32_t y = 1;
+    uint32_t z = 1;
+};
+
+// The constructor sets up descriptors and the pipeline layout; the pipeline itself is compiled by
+// CreatePipelines(), which builds the pipelines of many kernels concurrently.
+class GemmKernel {
+  public:
+    GemmKernel(
+        VulkanRuntime& vulkanRuntime,
+        const VkCooperativeMatrixPropertiesKHR& property,
+        const GemmKernelConfig& config);
+    ~GemmKernel();
+    GemmKernel(const GemmKernel&) = delete;
+    GemmKernel& operator=(const GemmKernel&) = delete;
+
+    // Must be called before the kernels record any dispatch.
+    static void CreatePipelines(PipelineRegistry& registry, const std::vector<GemmKernel*>& gemmKernels);
+
+    // Whether a compute_nv.comp variant is built for the component types of this cooperative matrix configuration.
+    static bool IsPropertySupported(const VkCooperativeMatrixPropertiesKHR& property);
+    // GetCooperativeMatrixTypeName() plus "_sat" when the configuration requires saturating accumulation.
+    static std::string GetShaderVariantName(const VkCooperativeMatrixPropertiesKHR& property);
+    // Epilogues other than the default one need integer accumulators.
+    static bool IsEpilogueSupported(const VkCooperativeMatrixPropertiesKHR& property, const GemmEpilogue& epilogue);
+    // Packed 4-bit B needs a float16 B type and groups of a multiple of 8 elements.
+    static bool IsInt4WeightsSupported(const VkCooperativeMatrixPropertiesKHR& property, uint32_t groupSize);
+
+    const VkCooperativeMatrixPropertiesKHR& GetProperty() const;
+    const GemmKernelConfig& GetConfig() const;
+    // "direct" or "shared", plus the layouts of A, B and C unless all are column major, e.g. "_rcc", "_packed" for
+    // packed operands, "_w4g" and the group size for packed 4-bit B, "_bda" for device address kernels and the
+    // epilogue steps, e.g. "_bias_relu_u8".
+    static std::string GetKernelName(const GemmKernelConfig& config);
+    std::string GetKernelName() const;
+    bool HasEpilogue() const;
+    // The type C is stored in: 8-bit with a requantizing epilogue, the result type otherwise.
+    VkComponentTypeKHR GetOutputComponentType() const;
+    bool IsShapeSupported(const GemmShape& shape) const;
+    GemmDispatchSize GetDispatchSize(const GemmShape& shape) const;
+    uint32_t GetBlockM() const;
+    uint32_t GetBlockN() const;
+    uint32_t GetSharedMemorySize() const;
+    // Whether every group is supported and all of them fit into one indirect dispatch.
+    bool IsGroupedDispatchSupported(const std::vector<GemmGroup>& groups) const;
+    // Whether the shape can be split into splitK partitions of K; a splitK of 1 means no split.
+    bool IsSplitKSupported(const GemmShape& shape, uint32_t splitK) const;
+    // Partitions for a split-K dispatch of the shape: enough to give every compute unit a couple of
+    // workgroups, as long as each partition keeps a useful depth of K. 1 when splitting does not pay off.
+    uint32_t GetSplitKFactor(const GemmShape& shape) const;
+    // Bytes of partial results a split-K dispatch writes.
+    VkDeviceSize GetSplitKWorkspaceSize(const GemmShape& shape, uint32_t splitK) const;
+    // Bytes of the row sums of A and column sums of B a dispatch with zero points writes.
+    VkDeviceSize GetQuantizationSumsSize(const GemmShape& shape) const;
+
+    // Descriptor sets a kernel has, so that dispatches on different buffers can be in flight at once.
+    static constexpr uint32_t kDescriptorSetCount = 2;
+
+    // Descriptor kernels only. Must not be called while a command buffer using the descriptor set is pending.
+    // If the runtime supports descriptor update-after-bind, recorded command buffers stay valid and use the new
+    // buffers when they are next submitted; otherwise they have to be recorded again.
+    void BindBuffers(const VulkanBuffer& a, const VulkanBuffer& b, const VulkanBuffer& c, uint32_t descriptorSet = 0);
+    // Descriptor kernels with an epilogue bias only. The bias holds N elements of the accumulator type.
+    void BindBias(const VulkanBuffer& bias, uint32_t descriptorSet = 0);
+    // Kernels with zero points only. The sums need GetQuantizationSumsSize() bytes for the dispatches recorded
+    // with this descriptor set; every dispatch computes them with quantized_sums.comp before the GEMM.
+    void BindQuantizationSums(const VulkanBuffer& sums, uint32_t descriptorSet = 0);
+    // GemmZeroPoints::PerColumn kernels only. zeroPointsB holds N int32 zero points.
+    void BindZeroPointsB(const VulkanBuffer& zeroPointsB, uint32_t descriptorSet = 0);
+    // Packed 4-bit B kernels only. scales holds one float per int4GroupSize elements of B, in the order of B and
+    // for every batch entry it spans.
+    void BindWeightScales(const VulkanBuffer& scales, uint32_t descriptorSet = 0);
+    // Pushed with every dispatch recorded afterwards.
+    void SetEpilogueParameters(const GemmEpilogueParameters& parameters);
+    // Covers the whole batch with one dispatch; gl_WorkGroupID.z selects the batch entry.
+    void RecordDispatch(VkCommandBuffer commandBuffer, const GemmShape& shape, uint32_t descriptorSet = 0) const;
+    void RecordDispatch(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides,
+        uint32_t descriptorSet = 0) const;
+    // Device address kernels only. Nothing is bound, so every dispatch may use different buffers; the buffers
+    // need VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT.
+    void RecordDispatch(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBufferAddresses& addresses) const;
+    void RecordDispatch(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides,
+        const GemmBufferAddresses& addresses) const;
+
+    // Split-K kernels only. The workspace needs GetSplitKWorkspaceSize() bytes for the dispatches recorded
+    // with this descriptor set.
+    void BindSplitKWorkspace(const VulkanBuffer& workspace, uint32_t descriptorSet = 0);
+    // Every one of splitK partitions of K, at least 2, multiplies into its own partial result; a second pass
+    // then sums them into C. Batch entries are packed.
+    void RecordSplitKDispatch(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, uint32_t splitK, uint32_t descriptorSet = 0) const;
+
+    // Descriptor kernels with packed operands only. Column-major A and B for RecordPackOperands(), which packs
+    // them into the A and B of BindBuffers().
+    void BindUnpackedOperands(const VulkanBuffer& a, const VulkanBuffer& b, uint32_t descriptorSet = 0);
+    // Packs the selected operands of a packed batch on the GPU and makes them visible to the dispatches that
+    // follow. Weights reused across dispatches only need packB the first time.
+    void RecordPackOperands(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, bool packA, bool packB,
+        uint32_t descriptorSet = 0) const;
+
+    // Grouped kernels only. groupTable holds GemmGroup entries and is filled on the GPU as well;
+    // dispatchArguments needs room for a VkDispatchIndirectCommand and indirect buffer usage.
+    void BindGroupTable(const VulkanBuffer& groupTable, const VulkanBuffer& dispatchArguments, uint32_t descriptorSet = 0);
+    // Runs the prologue that turns the first groupCount groups into workgroup ranges, then the GEMMs of all
+    // groups with one vkCmdDispatchIndirect. The group table only has to be written before this executes.
+    void RecordGroupedDispatch(VkCommandBuffer commandBuffer, uint32_t groupCount, uint32_t descriptorSet = 0) const;
+
+  private:
+    void CreateDescriptorSets(bool updateAfterBind);
+    void WriteStorageBuffers(uint32_t descriptorSet, uint32_t firstBinding, const std::vector<VkBuffer>& buffers);
+    void AssertDispatchSupported(const GemmShape& shape, const GemmBatchStrides& strides) const;
+    void RecordQuantizationSums(
+        VkCommandBuffer commandBuffer, const GemmShape& shape, const GemmBatchStrides& strides) const;
+
+    VkDevice mDevice;
+    VkCooperativeMatrixPropertiesKHR mProperty;
+    GemmKernelConfig mConfig;
+    VkPhysicalDeviceLimits mLimits;
+    uint32_t mComputeUnitCount;
+    GemmEpilogueParameters mEpilogueParameters;
+    // Bound to every binding of every descriptor set but A, B and C until it is replaced by one of the Bind
+    // functions, as compute_nv.comp always references them. Device address kernels have no descriptor sets.
+    VulkanBuffer mPlaceholderBuffer;
+
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, kDescriptorSetCount> mDescriptorSets = {};
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    PipelineRequest mPipelineRequest;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+    PipelineRequest mProloguePipelineRequest;
+    VkPipeline mProloguePipeline = VK_NULL_HANDLE;
+    PipelineRequest mReducePipelineRequest;
+    VkPipeline mReducePipeline = VK_NULL_HANDLE;
+    PipelineRequest mSumsPipelineRequest;
+    VkPipeline mSumsPipeline = VK_NULL_HANDLE;
+    PipelineRequest mPackPipelineRequest;
+    VkPipeline mPackPipeline = VK_NULL_HANDLE;
+    std::array<VkBuffer, kDescriptorSetCount> mDispatchArgumentBuffers = {};
+};
+
+#endif
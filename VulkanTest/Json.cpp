@@ -0,0 +1,376 @@
+#include "Json.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    class JsonParser {
+      public:
+        explicit JsonParser(const std::string& text) : mText(text) {}
+
+        bool ParseDocument(JsonValue* value, std::string* error) {
+            bool success = ParseValue(value, 0) && (SkipWhitespace(), mPosition == mText.size());
+            if (!success && error != nullptr) {
+                *error = "invalid JSON near offset " + std::to_string(mPosition);
+            }
+            return success;
+        }
+
+      private:
+        static constexpr uint32_t kMaxDepth = 64;
+
+        void SkipWhitespace() {
+            while (mPosition < mText.size() &&
+                (mText[mPosition] == ' ' || mText[mPosition] == '\t' ||
+                 mText[mPosition] == '\n' || mText[mPosition] == '\r')) {
+                ++mPosition;
+            }
+        }
+
+        bool Consume(char c) {
+            SkipWhitespace();
+            if (mPosition < mText.size() && mText[mPosition] == c) {
+                ++mPosition;
+                return true;
+            }
+            return false;
+        }
+
+        bool ConsumeLiteral(const char* literal) {
+            size_t length = std::char_traits<char>::length(literal);
+            if (mText.compare(mPosition, length, literal) != 0) {
+                return false;
+            }
+            mPosition += length;
+            return true;
+        }
+
+        bool ParseValue(JsonValue* value, uint32_t depth) {
+            if (depth > kMaxDepth) {
+                return false;
+            }
+            SkipWhitespace();
+            if (mPosition >= mText.size()) {
+                return false;
+            }
+            char c = mText[mPosition];
+            if (c == '{') {
+                ++mPosition;
+                *value = JsonValue::MakeObject();
+                if (Consume('}')) {
+                    return true;
+                }
+                do {
+                    std::string key;
+                    JsonValue member;
+                    if (!(SkipWhitespace(), ParseString(&key)) || !Consume(':') || !ParseValue(&member, depth + 1)) {
+                        return false;
+                    }
+                    (*value)[key] = std::move(member);
+                } while (Consume(','));
+                return Consume('}');
+            }
+            if (c == '[') {
+                ++mPosition;
+                *value = JsonValue::MakeArray();
+                if (Consume(']')) {
+                    return true;
+                }
+                do {
+                    JsonValue element;
+                    if (!ParseValue(&element, depth + 1)) {
+                        return false;
+                    }
+                    value->Append(std::move(element));
+                } while (Consume(','));
+                return Consume(']');
+            }
+            if (c == '"') {
+                std::string string;
+                if (!ParseString(&string)) {
+                    return false;
+                }
+                *value = JsonValue(std::move(string));
+                return true;
+            }
+            if (ConsumeLiteral("true")) {
+                *value = JsonValue(true);
+                return true;
+            }
+            if (ConsumeLiteral("false")) {
+                *value = JsonValue(false);
+                return true;
+            }
+            if (ConsumeLiteral("null")) {
+                *value = JsonValue();
+                return true;
+            }
+            const char* begin = mText.c_str() + mPosition;
+            char* end = nullptr;
+            double number = strtod(begin, &end);
+            if (end == begin) {
+                return false;
+            }
+            mPosition += end - begin;
+            *value = JsonValue(number);
+            return true;
+        }
+
+        bool ParseString(std::string* string) {
+            if (mPosition >= mText.size() || mText[mPosition] != '"') {
+                return false;
+            }
+            ++mPosition;
+            while (mPosition < mText.size()) {
+                char c = mText[mPosition++];
+                if (c == '"') {
+                    return true;
+                }
+                if (c != '\\') {
+                    string->push_back(c);
+                    continue;
+                }
+                if (mPosition >= mText.size()) {
+                    return false;
+                }
+                char escaped = mText[mPosition++];
+                switch (escaped) {
+                    case 'b': string->push_back('\b'); break;
+                    case 'f': string->push_back('\f'); break;
+                    case 'n': string->push_back('\n'); break;
+                    case 'r': string->push_back('\r'); break;
+                    case 't': string->push_back('\t'); break;
+                    case 'u': {
+                        if (mPosition + 4 > mText.size()) {
+                            return false;
+                        }
+                        uint32_t codePoint = static_cast<uint32_t>(
+                            strtoul(mText.substr(mPosition, 4).c_str(), nullptr, 16));
+                        mPosition += 4;
+                        // Only the basic multilingual plane is needed for the files this tool writes.
+                        if (codePoint < 0x80) {
+                            string->push_back(static_cast<char>(codePoint));
+                        } else if (codePoint < 0x800) {
+                            string->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                            string->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+                        } else {
+                            string->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                            string->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                            string->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+                        }
+                        break;
+                    }
+                    default: string->push_back(escaped); break;
+                }
+            }
+            return false;
+        }
+
+        const std::string& mText;
+        size_t mPosition = 0;
+    };
+
+    void AppendEscapedString(std::string* output, const std::string& string) {
+        output->push_back('"');
+        for (char c : string) {
+            switch (c) {
+                case '"': output->append("\\\""); break;
+                case '\\': output->append("\\\\"); break;
+                case '\n': output->append("\\n"); break;
+                case '\r': output->append("\\r"); break;
+                case '\t': output->append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buffer[8];
+                        snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                        output->append(buffer);
+                    } else {
+                        output->push_back(c);
+                    }
+                    break;
+            }
+        }
+        output->push_back('"');
+    }
+
+    void AppendIndent(std::string* output, uint32_t indent) {
+        output->push_back('\n');
+        output->append(indent * 2, ' ');
+    }
+}  // anonymous namespace
+
+JsonValue::JsonValue(bool value) : mType(Type::Bool), mBool(value) {}
+
+JsonValue::JsonValue(const char* value) : mType(Type::String), mString(value) {}
+
+JsonValue::JsonValue(std::string value) : mType(Type::String), mString(std::move(value)) {}
+
+JsonValue JsonValue::MakeArray() {
+    JsonValue value;
+    value.mType = Type::Array;
+    return value;
+}
+
+JsonValue JsonValue::MakeObject() {
+    JsonValue value;
+    value.mType = Type::Object;
+    return value;
+}
+
+JsonValue::Type JsonValue::GetType() const {
+    return mType;
+}
+
+bool JsonValue::IsNull() const {
+    return mType == Type::Null;
+}
+
+bool JsonValue::AsBool() const {
+    return mType == Type::Bool && mBool;
+}
+
+double JsonValue::AsNumber() const {
+    return mType == Type::Number ? mNumber : 0.0;
+}
+
+const std::string& JsonValue::AsString() const {
+    return mString;
+}
+
+const std::vector<JsonValue>& JsonValue::AsArray() const {
+    return mArray;
+}
+
+const std::vector<std::pair<std::string, JsonValue>>& JsonValue::AsObject() const {
+    return mObject;
+}
+
+void JsonValue::Append(JsonValue value) {
+    mType = Type::Array;
+    mArray.push_back(std::move(value));
+}
+
+JsonValue& JsonValue::operator[](const std::string& key) {
+    mType = Type::Object;
+    for (auto& member : mObject) {
+        if (member.first == key) {
+            return member.second;
+        }
+    }
+    mObject.emplace_back(key, JsonValue());
+    return mObject.back().second;
+}
+
+const JsonValue* JsonValue::Find(const std::string& key) const {
+    for (const auto& member : mObject) {
+        if (member.first == key) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::GetNumber(const std::string& key, double defaultValue) const {
+    const JsonValue* member = Find(key);
+    return member != nullptr && member->mType == Type::Number ? member->mNumber : defaultValue;
+}
+
+std::string JsonValue::GetString(const std::string& key, const std::string& defaultValue) const {
+    const JsonValue* member = Find(key);
+    return member != nullptr && member->mType == Type::String ? member->mString : defaultValue;
+}
+
+std::string JsonValue::Serialize() const {
+    std::string output;
+    Serialize(&output, 0);
+    output.push_back('\n');
+    return output;
+}
+
+void JsonValue::Serialize(std::string* output, uint32_t indent) const {
+    switch (mType) {
+        case Type::Null:
+            output->append("null");
+            break;
+        case Type::Bool:
+            output->append(mBool ? "true" : "false");
+            break;
+        case Type::Number: {
+            char buffer[32];
+            if (!std::isfinite(mNumber)) {
+                output->append("null");
+                break;
+            }
+            if (std::floor(mNumber) == mNumber && std::fabs(mNumber) < 9007199254740992.0) {
+                snprintf(buffer, sizeof(buffer), "%.0f", mNumber);
+            } else {
+                snprintf(buffer, sizeof(buffer), "%.10g", mNumber);
+            }
+            output->append(buffer);
+            break;
+        }
+        case Type::String:
+            AppendEscapedString(output, mString);
+            break;
+        case Type::Array:
+            output->push_back('[');
+            for (size_t i = 0; i < mArray.size(); ++i) {
+                AppendIndent(output, indent + 1);
+                mArray[i].Serialize(output, indent + 1);
+                if (i + 1 < mArray.size()) {
+                    output->push_back(',');
+                }
+            }
+            if (!mArray.empty()) {
+                AppendIndent(output, indent);
+            }
+            output->push_back(']');
+            break;
+        case Type::Object:
+            output->push_back('{');
+            for (size_t i = 0; i < mObject.size(); ++i) {
+                AppendIndent(output, indent + 1);
+                AppendEscapedString(output, mObject[i].first);
+                output->append(": ");
+                mObject[i].second.Serialize(output, indent + 1);
+                if (i + 1 < mObject.size()) {
+                    output->push_back(',');
+                }
+            }
+            if (!mObject.empty()) {
+                AppendIndent(output, indent);
+            }
+            output->push_back('}');
+            break;
+    }
+}
+
+bool JsonValue::Parse(const std::string& text, JsonValue* value, std::string* error) {
+    JsonParser parser(text);
+    return parser.ParseDocument(value, error);
+}
+
+bool ReadJsonFile(const std::string& path, JsonValue* value, std::string* error) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        if (error != nullptr) {
+            *error = "could not open \"" + path + "\"";
+        }
+        return false;
+    }
+    std::ostringstream contents;
+    contents << stream.rdbuf();
+    return JsonValue::Parse(contents.str(), value, error);
+}
+
+bool WriteJsonFile(const std::string& path, const JsonValue& value) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+        return false;
+    }
+    stream << value.Serialize();
+    return stream.good();
+}
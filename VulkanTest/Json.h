@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef JSON_H_
+#define JSON_H_
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document used for benchmark reports, baselines and other files the tool reads back.
+// Object members keep their insertion order so that written files are stable and diffable.
+class JsonValue {
+  public:
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    JsonValue() = default;
+    JsonValue(bool value);
+    JsonValue(const char* value);
+    JsonValue(std::string value);
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+    JsonValue(T value) : mType(Type::Number), mNumber(static_cast<double>(value)) {}
+
+    static JsonValue MakeArray();
+    static JsonValue MakeObject();
+
+    Type GetType() const;
+    bool IsNull() const;
+    bool AsBool() const;
+    double AsNumber() const;
+    const std::string& AsString() const;
+    const std::vector<JsonValue>& AsArray() const;
+    const std::vector<std::pair<std::string, JsonValue>>& AsObject() const;
+
+    void Append(JsonValue value);
+    // Inserts the member if it does not exist yet.
+    JsonValue& operator[](const std::string& key);
+    const JsonValue* Find(const std::string& key) const;
+    // Convenience lookups that fall back to the given default when the member is missing or mistyped.
+    double GetNumber(const std::string& key, double defaultValue) const;
+    std::string GetString(const std::string& key, const std::string& defaultValue) const;
+
+    std::string Serialize() const;
+    static bool Parse(const std::string& text, JsonValue* value, std::string* error);
+
+  private:
+    void Serialize(std::string* output, uint32_t indent) const;
+
+    Type mType = Type::Null;
+    bool mBool = false;
+    double mNumber = 0.0;
+    std::string mString;
+    std::vector<JsonValue> mArray;
+    std::vector<std::pair<std::string, JsonValue>> mObject;
+};
+
+bool ReadJsonFile(const std::string& path, JsonValue* value, std::string* error);
+bool WriteJsonFile(const std::string& path, const JsonValue& value);
+
+#endif
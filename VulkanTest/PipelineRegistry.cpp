@@ -0,0 +1,83 @@
+#include "PipelineRegistry.h"
+
+PipelineRegistry::PipelineRegistry(VulkanRuntime& vulkanRuntime, ThreadPool& threadPool)
+    : mVulkanRuntime(vulkanRuntime),
+      mThreadPool(threadPool),
+      mDevice(vulkanRuntime.GetLogicalDevice()) {
+}
+
+PipelineRegistry::~PipelineRegistry() {
+    for (const auto& shaderModule : mShaderModules) {
+        vkDestroyShaderModule(mDevice, shaderModule.second, nullptr);
+    }
+}
+
+std::vector<VkPipeline> PipelineRegistry::CreatePipelines(const std::vector<PipelineRequest>& requests) {
+    // Modules are created up front so that the workers only ever read mShaderModules.
+    std::vector<VkShaderModule> shaderModules(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        shaderModules[i] = GetShaderModule(requests[i].shaderPath);
+    }
+
+    std::vector<VkPipeline> pipelines(requests.size(), VK_NULL_HANDLE);
+    VulkanPipelineCache& pipelineCache = mVulkanRuntime.GetPipelineCache();
+    mThreadPool.ParallelFor(static_cast<uint32_t>(requests.size()), [&](uint32_t index) {
+        const PipelineRequest& request = requests[index];
+        std::vector<VkSpecializationMapEntry> entries(request.specializationConstants.size());
+        for (uint32_t i = 0; i < entries.size(); ++i) {
+            entries[i] = { i, static_cast<uint32_t>(sizeof(uint32_t) * i), sizeof(uint32_t) };
+        }
+        VkSpecializationInfo specInfo = {
+            static_cast<uint32_t>(entries.size()),
+            entries.data(),
+            request.specializationConstants.size() * sizeof(uint32_t),
+            request.specializationConstants.data(),
+        };
+        VkPipelineShaderStageRequiredSubgroupSizeCreateInfo requiredSubgroupSizeCreateInfo = {};
+        requiredSubgroupSizeCreateInfo.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO;
+        requiredSubgroupSizeCreateInfo.requiredSubgroupSize = request.requiredSubgroupSize;
+
+        VkComputePipelineCreateInfo computePipelineCreateInfo = {};
+        computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        computePipelineCreateInfo.stage.module = shaderModules[index];
+        computePipelineCreateInfo.stage.pName = "main";
+        computePipelineCreateInfo.stage.flags = request.stageFlags;
+        computePipelineCreateInfo.stage.pNext =
+            request.requiredSubgroupSize != 0 ? &requiredSubgroupSizeCreateInfo : nullptr;
+        computePipelineCreateInfo.stage.pSpecializationInfo = &specInfo;
+        computePipelineCreateInfo.layout = request.layout;
+        pipelines[index] = pipelineCache.CreateComputePipeline(computePipelineCreateInfo, GetVariantKey(request));
+    });
+    return pipelines;
+}
+
+std::string PipelineRegistry::GetVariantKey(const PipelineRequest& request) {
+    std::string key = request.shaderPath;
+    for (uint32_t value : request.specializationConstants) {
+        key += ":" + std::to_string(value);
+    }
+    if (request.requiredSubgroupSize != 0) {
+        key += ":subgroup" + std::to_string(request.requiredSubgroupSize);
+    }
+    return key;
+}
+
+uint32_t PipelineRegistry::GetShaderModuleCount() const {
+    return static_cast<uint32_t>(mShaderModules.size());
+}
+
+VkShaderModule PipelineRegistry::GetShaderModule(const std::string& shaderPath) {
+    auto found = mShaderModules.find(shaderPath);
+    if (found != mShaderModules.end()) {
+        return found->second;
+    }
+    VkShaderModule shaderModule = mVulkanRuntime.LoadShader(shaderPath.c_str(), VK_SHADER_STAGE_COMPUTE_BIT).module;
+    if (shaderModule == VK_NULL_HANDLE) {
+        exit(1);
+    }
+    mShaderModules[shaderPath] = shaderModule;
+    return shaderModule;
+}
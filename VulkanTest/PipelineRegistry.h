@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef PIPELINE_REGISTRY_H_
+#define PIPELINE_REGISTRY_H_
+
+#include "ThreadPool.h"
+#include "VulkanHelper.h"
+
+// One compute pipeline variant: a SPIR-V file, the values of its specialization constants 0..n-1 and a layout.
+struct PipelineRequest {
+    std::string shaderPath;
+    std::vector<uint32_t> specializationConstants;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkPipelineShaderStageCreateFlags stageFlags = 0;
+    // 0 leaves the subgroup size to the driver.
+    uint32_t requiredSubgroupSize = 0;
+};
+
+// Compiles batches of compute pipelines concurrently on a thread pool. Every SPIR-V file is read and turned
+// into a shader module once and kept for later batches. Pipelines go through the runtime pipeline cache.
+class PipelineRegistry {
+  public:
+    PipelineRegistry(VulkanRuntime& vulkanRuntime, ThreadPool& threadPool);
+    ~PipelineRegistry();
+    PipelineRegistry(const PipelineRegistry&) = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+    // Returns one pipeline per request, in request order; the caller destroys them.
+    std::vector<VkPipeline> CreatePipelines(const std::vector<PipelineRequest>& requests);
+
+    // Identifies the variant in the pipeline cache: shader path, specialization constants and subgroup size.
+    static std::string GetVariantKey(const PipelineRequest& request);
+
+    uint32_t GetShaderModuleCount() const;
+
+  private:
+    VkShaderModule GetShaderModule(const std::string& shaderPath);
+
+    VulkanRuntime& mVulkanRuntime;
+    ThreadPool& mThreadPool;
+    VkDevice mDevice;
+    std::map<std::string, VkShaderModule> mShaderModules;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        mQueues.push_back(std::make_unique<TaskQueue>());
+    }
+    // The last queue belongs to the thread calling ParallelFor().
+    for (uint32_t i = 0; i + 1 < threadCount; ++i) {
+        mWorkers.emplace_back(&ThreadPool::WorkerMain, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWakeCondition.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::GetThreadCount() const {
+    return static_cast<uint32_t>(mQueues.size());
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> parallelForLock(mParallelForMutex);
+
+    uint32_t queueCount = GetThreadCount();
+    for (uint32_t i = 0; i < queueCount; ++i) {
+        uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / queueCount);
+        uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / queueCount);
+        std::lock_guard<std::mutex> queueLock(mQueues[i]->mutex);
+        for (uint32_t index = begin; index < end; ++index) {
+            mQueues[i]->indices.push_back(index);
+        }
+    }
+    mRemainingTasks = count;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mPendingWorkers = static_cast<uint32_t>(mWorkers.size());
+        ++mGeneration;
+    }
+    mWakeCondition.notify_all();
+
+    RunTasks(queueCount - 1, task);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mRemainingTasks == 0 && mPendingWorkers == 0; });
+    mTask = nullptr;
+}
+
+void ThreadPool::WorkerMain(uint32_t queueIndex) {
+    uint64_t generation = 0;
+    while (true) {
+        const std::function<void(uint32_t)>* task = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [this, generation] { return mStopping || mGeneration != generation; });
+            if (mStopping) {
+                return;
+            }
+            generation = mGeneration;
+            task = mTask;
+        }
+        RunTasks(queueIndex, *task);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mPendingWorkers;
+        }
+        mDoneCondition.notify_all();
+    }
+}
+
+void ThreadPool::RunTasks(uint32_t queueIndex, const std::function<void(uint32_t)>& task) {
+    uint32_t index;
+    while (PopTask(queueIndex, &index)) {
+        task(index);
+        if (--mRemainingTasks == 0) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDoneCondition.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::PopTask(uint32_t queueIndex, uint32_t* index) {
+    {
+        TaskQueue& queue = *mQueues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.indices.empty()) {
+            *index = queue.indices.front();
+            queue.indices.pop_front();
+            return true;
+        }
+    }
+    uint32_t queueCount = GetThreadCount();
+    for (uint32_t offset = 1; offset < queueCount; ++offset) {
+        TaskQueue& victim = *mQueues[(queueIndex + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.indices.empty()) {
+            *index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
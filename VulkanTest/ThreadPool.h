@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running ParallelFor() loops. Every thread, including the caller, owns a
+// queue seeded with a contiguous range of indices; threads that run out of work steal from the back of
+// the other queues, so uneven tasks still balance out.
+class ThreadPool {
+  public:
+    // threadCount includes the calling thread; 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t GetThreadCount() const;
+
+    // Runs task(index) for every index in [0, count) and returns once all of them have finished.
+    // Calls from several threads are serialized; task must not call ParallelFor() itself.
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+  private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<uint32_t> indices;
+    };
+
+    void WorkerMain(uint32_t queueIndex);
+    void RunTasks(uint32_t queueIndex, const std::function<void(uint32_t)>& task);
+    bool PopTask(uint32_t queueIndex, uint32_t* index);
+
+    std::vector<std::unique_ptr<TaskQueue>> mQueues;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mParallelForMutex;
+    std::mutex mMutex;
+    std::condition_variable mWakeCondition;
+    std::condition_variable mDoneCondition;
+    const std::function<void(uint32_t)>* mTask = nullptr;
+    uint64_t mGeneration = 0;
+    // Workers that have not yet finished with the current generation; ParallelFor() waits for all of
+    // them so that no worker can still be holding mTask when it returns.
+    uint32_t mPendingWorkers = 0;
+    std::atomic<uint32_t> mRemainingTasks{0};
+    bool mStopping = false;
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include "Verification.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+namespace {
+    // Arithmetic modulo the Mersenne prime 2^61 - 1, in 64-bit integers only.
+    constexpr uint64_t kModulus = (1ull << 61) - 1;
+
+    uint64_t ReduceModulus(uint64_t value) {
+        value = (value & kModulus) + (value >> 61);
+        return value >= kModulus ? value - kModulus : value;
+    }
+
+    uint64_t MultiplyModulus(uint64_t x, uint64_t y) {
+        uint64_t xHigh = x >> 32;
+        uint64_t xLow = x & 0xFFFFFFFF;
+        uint64_t yHigh = y >> 32;
+        uint64_t yLow = y & 0xFFFFFFFF;
+        uint64_t middle = xHigh * yLow + xLow * yHigh;
+        // 2^64 is 8 and 2^61 is 1 modulo 2^61 - 1; every term is below 2^61 except middle >> 29.
+        return ReduceModulus((xHigh * yHigh << 3) + (middle >> 29) + ((middle & 0x1FFFFFFF) << 32) +
+            ReduceModulus(xLow * yLow));
+    }
+
+    uint64_t ToResidue(int64_t value) {
+        return value < 0 ? kModulus - static_cast<uint64_t>(-value) : static_cast<uint64_t>(value);
+    }
+
+    template <typename Type>
+    uint64_t GetMaxMagnitude() {
+        return std::max(static_cast<uint64_t>(std::numeric_limits<Type>::max()),
+            static_cast<uint64_t>(-static_cast<int64_t>(std::numeric_limits<Type>::min())));
+    }
+
+    // Check of the exact products modulo 2^61 - 1, for accumulators that cannot wrap. Errors are below 2^33
+    // in magnitude and so never a multiple of the modulus: a wrong row passes with probability 1 / (2^61 - 1).
+    template <typename AType, typename BType, typename CType>
+    bool VerifyExactIntegerTrial(
+        const GemmShape& shape, const AType* a, const BType* b, const CType* c, std::mt19937_64& random) {
+        std::uniform_int_distribution<uint64_t> distribution(0, kModulus - 1);
+        std::vector<uint64_t> r(shape.n);
+        for (uint64_t& value : r) {
+            value = distribution(random);
+        }
+
+        std::vector<uint64_t> br(shape.k, 0);
+        for (uint32_t j = 0; j < shape.n; ++j) {
+            const BType* column = b + static_cast<uint64_t>(j) * shape.k;
+            for (uint32_t k = 0; k < shape.k; ++k) {
+                br[k] = ReduceModulus(br[k] + MultiplyModulus(ToResidue(column[k]), r[j]));
+            }
+        }
+        std::vector<uint64_t> abr(shape.m, 0);
+        for (uint32_t k = 0; k < shape.k; ++k) {
+            const AType* column = a + static_cast<uint64_t>(k) * shape.m;
+            for (uint32_t i = 0; i < shape.m; ++i) {
+                abr[i] = ReduceModulus(abr[i] + MultiplyModulus(ToResidue(column[i]), br[k]));
+            }
+        }
+        std::vector<uint64_t> cr(shape.m, 0);
+        for (uint32_t j = 0; j < shape.n; ++j) {
+            const CType* column = c + static_cast<uint64_t>(j) * shape.m;
+            for (uint32_t i = 0; i < shape.m; ++i) {
+                cr[i] = ReduceModulus(cr[i] + MultiplyModulus(ToResidue(column[i]), r[j]));
+            }
+        }
+        return cr == abr;
+    }
+
+    // Check modulo 2^32, for accumulators that may wrap; signed accumulators are compared through their two's
+    // complement bits. A wrong row passes with probability at most 1/2: 2^31 * r[j] vanishes for every even
+    // r[j].
+    template <typename AType, typename BType, typename CType>
+    bool VerifyIntegerTrial(
+        const GemmShape& shape, const AType* a, const BType* b, const CType* c, std::mt19937_64& random) {
+        std::vector<uint32_t> r(shape.n);
+        for (uint32_t& value : r) {
+            value = static_cast<uint32_t>(random());
+        }
+
+        std::vector<uint32_t> br(shape.k, 0);
+        for (uint32_t j = 0; j < shape.n; ++j) {
+            const BType* column = b + static_cast<uint64_t>(j) * shape.k;
+            for (uint32_t k = 0; k < shape.k; ++k) {
+                br[k] += static_cast<uint32_t>(column[k]) * r[j];
+            }
+        }
+        std::vector<uint32_t> abr(shape.m, 0);
+        for (uint32_t k = 0; k < shape.k; ++k) {
+            const AType* column = a + static_cast<uint64_t>(k) * shape.m;
+            for (uint32_t i = 0; i < shape.m; ++i) {
+                abr[i] += static_cast<uint32_t>(column[i]) * br[k];
+            }
+        }
+        std::vector<uint32_t> cr(shape.m, 0);
+        for (uint32_t j = 0; j < shape.n; ++j) {
+            const CType* column = c + static_cast<uint64_t>(j) * shape.m;
+            for (uint32_t i = 0; i < shape.m; ++i) {
+                cr[i] += static_cast<uint32_t>(column[i]) * r[j];
+            }
+        }
+        return cr == abr;
+    }
+
+    template <typename AType, typename BType, typename CType>
+    bool VerifyInteger(
+        const GemmShape& shape, const void* a, const void* b, const void* c, uint32_t trials, uint64_t seed) {
+        // K products of the largest magnitude fit into CType, so C holds the exact products.
+        const bool exact = static_cast<uint64_t>(shape.k) * GetMaxMagnitude<AType>() * GetMaxMagnitude<BType>() <=
+            static_cast<uint64_t>(std::numeric_limits<CType>::max());
+        std::mt19937_64 random(seed);
+        for (uint32_t trial = 0; trial < trials; ++trial) {
+            const AType* typedA = static_cast<const AType*>(a);
+            const BType* typedB = static_cast<const BType*>(b);
+            const CType* typedC = static_cast<const CType*>(c);
+            if (exact ? !VerifyExactIntegerTrial(shape, typedA, typedB, typedC, random)
+                      : !VerifyIntegerTrial(shape, typedA, typedB, typedC, random)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VerifyFloat(
+        const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape,
+        const void* a, const void* b, const void* c, uint32_t trials, uint64_t seed) {
+        // For random inputs the rounding error of C[i][j] is on the order of epsilon * |A row i| * |B column j|,
+        // so the error of (C * r)[i] is on the order of epsilon * |A row i| * |(|B column j| * r[j])_j|.
+        // The tolerance allows several standard deviations of that; single elements that are off by less
+        // than the accumulated rounding noise cannot be told apart from it.
+        double epsilon = property.CType == VK_COMPONENT_TYPE_FLOAT16_KHR ? std::ldexp(1.0, -10) : std::ldexp(1.0, -23);
+        double tolerance = 8.0 * epsilon;
+
+        std::mt19937_64 random(seed);
+        std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+        for (uint32_t trial = 0; trial < trials; ++trial) {
+            std::vector<double> r(shape.n);
+            for (double& value : r) {
+                value = distribution(random);
+            }
+
+            std::vector<double> br(shape.k, 0.0);
+            double scaledColumnNorms = 0.0;
+            for (uint32_t j = 0; j < shape.n; ++j) {
+                double columnNorm = 0.0;
+                for (uint32_t k = 0; k < shape.k; ++k) {
+                    double value = ReadComponent(b, property.BType, k + static_cast<uint64_t>(j) * shape.k);
+                    br[k] += value * r[j];
+                    columnNorm += value * value;
+                }
+                scaledColumnNorms += columnNorm * r[j] * r[j];
+            }
+            std::vector<double> abr(shape.m, 0.0);
+            std::vector<double> rowNorms(shape.m, 0.0);
+            for (uint32_t k = 0; k < shape.k; ++k) {
+                for (uint32_t i = 0; i < shape.m; ++i) {
+                    double value = ReadComponent(a, property.AType, i + static_cast<uint64_t>(k) * shape.m);
+                    abr[i] += value * br[k];
+                    rowNorms[i] += value * value;
+                }
+            }
+            std::vector<double> cr(shape.m, 0.0);
+            for (uint32_t j = 0; j < shape.n; ++j) {
+                for (uint32_t i = 0; i < shape.m; ++i) {
+                    cr[i] += ReadComponent(c, property.ResultType, i + static_cast<uint64_t>(j) * shape.m) * r[j];
+                }
+            }
+            for (uint32_t i = 0; i < shape.m; ++i) {
+                double bound = tolerance * std::sqrt(rowNorms[i] * scaledColumnNorms) + epsilon;
+                if (!(std::abs(cr[i] - abr[i]) <= bound)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Components of integer types as 32-bit two's complement bits.
+    uint32_t ReadIntegerComponent(const void* data, VkComponentTypeKHR componentType, uint64_t index) {
+        return static_cast<uint32_t>(static_cast<int64_t>(ReadComponent(data, componentType, index)));
+    }
+
+    // The epilogue of compute_nv.comp on one accumulator, returned as the bits of the stored element.
+    uint32_t ApplyEpilogue(
+        uint32_t value, bool signedResult, const GemmEpilogue& epilogue, const GemmEpilogueParameters& parameters) {
+        if (epilogue.activation == GemmActivation::Relu && signedResult && static_cast<int32_t>(value) < 0) {
+            value = 0;
+        } else if (epilogue.activation == GemmActivation::Clamp && signedResult) {
+            int32_t low = static_cast<int32_t>(parameters.clampMin);
+            int32_t high = static_cast<int32_t>(parameters.clampMax);
+            value = static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(value), low), high));
+        } else if (epilogue.activation == GemmActivation::Clamp) {
+            uint32_t low = static_cast<uint32_t>(static_cast<int64_t>(parameters.clampMin));
+            uint32_t high = static_cast<uint32_t>(static_cast<int64_t>(parameters.clampMax));
+            value = std::min(std::max(value, low), high);
+        }
+        if (epilogue.outputType == GemmOutputType::Accumulator) {
+            return value;
+        }
+        // Float arithmetic in the default rounding mode, nearest even, like the shader.
+        float converted = signedResult ? static_cast<float>(static_cast<int32_t>(value)) : static_cast<float>(value);
+        float scaled = std::nearbyint(converted * parameters.scale);
+        if (epilogue.outputType == GemmOutputType::Uint8) {
+            return static_cast<uint32_t>(std::min(std::max(scaled, 0.0f), 255.0f));
+        }
+        return static_cast<uint8_t>(static_cast<int32_t>(std::min(std::max(scaled, -128.0f), 127.0f)));
+    }
+}  // anonymous namespace
+
+void FillRandomComponents(void* data, VkComponentTypeKHR componentType, uint64_t count, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    if (IsFloatComponentType(componentType)) {
+        std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+        for (uint64_t i = 0; i < count; ++i) {
+            WriteComponent(data, componentType, i, distribution(random));
+        }
+    } else {
+        // WriteComponent() truncates to the component width, which keeps every bit pattern equally likely.
+        for (uint64_t i = 0; i < count; ++i) {
+            WriteComponent(data, componentType, i, static_cast<double>(random() & 0xFFFFFFFF));
+        }
+    }
+}
+
+void DequantizeInt4Weights(
+    const uint8_t* packed, const float* scales, uint64_t elementCount, uint32_t groupSize, uint16_t* b) {
+    for (uint64_t i = 0; i < elementCount; ++i) {
+        // Sign-extend the nibble through the top of an int8.
+        int8_t weight = static_cast<int8_t>(static_cast<uint8_t>(packed[i / 2] >> (i % 2 * 4) << 4)) >> 4;
+        b[i] = FloatToHalf(static_cast<float>(weight) * scales[i / groupSize]);
+    }
+}
+
+void TransposeToColumnMajor(
+    const void* rowMajor, uint32_t rows, uint32_t columns, uint32_t batch, uint32_t elementSize,
+    void* columnMajor) {
+    const uint8_t* source = static_cast<const uint8_t*>(rowMajor);
+    uint8_t* destination = static_cast<uint8_t*>(columnMajor);
+    uint64_t entrySize = static_cast<uint64_t>(rows) * columns * elementSize;
+    for (uint32_t entry = 0; entry < batch; ++entry) {
+        for (uint32_t row = 0; row < rows; ++row) {
+            for (uint32_t column = 0; column < columns; ++column) {
+                memcpy(destination + (static_cast<uint64_t>(column) * rows + row) * elementSize,
+                    source + (static_cast<uint64_t>(row) * columns + column) * elementSize, elementSize);
+            }
+        }
+        source += entrySize;
+        destination += entrySize;
+    }
+}
+
+bool VerifyGemmFreivalds(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape,
+    const void* a, const void* b, const void* c, uint32_t trials, uint64_t seed) {
+    if (shape.batch > 1) {
+        GemmShape entryShape = shape;
+        entryShape.batch = 1;
+        uint64_t entrySizeA = static_cast<uint64_t>(shape.m) * shape.k * GetComponentTypeSize(property.AType);
+        uint64_t entrySizeB = static_cast<uint64_t>(shape.k) * shape.n * GetComponentTypeSize(property.BType);
+        uint64_t entrySizeC = static_cast<uint64_t>(shape.m) * shape.n * GetComponentTypeSize(property.ResultType);
+        for (uint32_t entry = 0; entry < shape.batch; ++entry) {
+            if (!VerifyGemmFreivalds(property, entryShape, static_cast<const uint8_t*>(a) + entry * entrySizeA,
+                    static_cast<const uint8_t*>(b) + entry * entrySizeB,
+                    static_cast<const uint8_t*>(c) + entry * entrySizeC, trials, seed + entry)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (IsFloatComponentType(property.ResultType)) {
+        return VerifyFloat(property, shape, a, b, c, trials, seed);
+    }
+
+    const VkComponentTypeKHR aType = property.AType;
+    const VkComponentTypeKHR bType = property.BType;
+    const bool signedResult = property.ResultType == VK_COMPONENT_TYPE_SINT32_KHR;
+    if (aType == VK_COMPONENT_TYPE_UINT8_KHR && bType == VK_COMPONENT_TYPE_UINT8_KHR && !signedResult) {
+        return VerifyInteger<uint8_t, uint8_t, uint32_t>(shape, a, b, c, trials, seed);
+    }
+    if (aType == VK_COMPONENT_TYPE_UINT8_KHR && bType == VK_COMPONENT_TYPE_UINT8_KHR) {
+        return VerifyInteger<uint8_t, uint8_t, int32_t>(shape, a, b, c, trials, seed);
+    }
+    if (aType == VK_COMPONENT_TYPE_SINT8_KHR && bType == VK_COMPONENT_TYPE_SINT8_KHR) {
+        return VerifyInteger<int8_t, int8_t, int32_t>(shape, a, b, c, trials, seed);
+    }
+    if (aType == VK_COMPONENT_TYPE_SINT8_KHR && bType == VK_COMPONENT_TYPE_UINT8_KHR) {
+        return VerifyInteger<int8_t, uint8_t, int32_t>(shape, a, b, c, trials, seed);
+    }
+    if (aType == VK_COMPONENT_TYPE_UINT8_KHR && bType == VK_COMPONENT_TYPE_SINT8_KHR) {
+        return VerifyInteger<uint8_t, int8_t, int32_t>(shape, a, b, c, trials, seed);
+    }
+    std::cerr << "Freivalds verification does not support " << GetCooperativeMatrixTypeName(property) << std::endl;
+    return false;
+}
+
+bool VerifyGemmEpilogueSamples(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape, const GemmEpilogue& epilogue,
+    const GemmEpilogueParameters& parameters, const void* a, const void* b, const void* bias,
+    const int32_t* zeroPointsB, const void* c, uint32_t sampleCount, uint64_t seed) {
+    if (IsFloatComponentType(property.ResultType)) {
+        std::cerr << "Epilogue verification does not support " << GetCooperativeMatrixTypeName(property) << std::endl;
+        return false;
+    }
+    const bool signedResult =
+        property.ResultType == VK_COMPONENT_TYPE_SINT32_KHR || epilogue.zeroPoints != GemmZeroPoints::None;
+    VkComponentTypeKHR outputType = property.ResultType;
+    if (epilogue.outputType == GemmOutputType::Uint8) {
+        outputType = VK_COMPONENT_TYPE_UINT8_KHR;
+    } else if (epilogue.outputType == GemmOutputType::Sint8) {
+        outputType = VK_COMPONENT_TYPE_SINT8_KHR;
+    }
+    const uint32_t outputMask = GetComponentTypeSize(outputType) == 1 ? 0xFF : 0xFFFFFFFF;
+
+    std::mt19937_64 random(seed);
+    GemmBatchStrides strides = GetPackedBatchStrides(shape);
+    for (uint32_t sample = 0; sample < sampleCount; ++sample) {
+        uint64_t entry = random() % shape.batch;
+        uint64_t i = random() % shape.m;
+        uint64_t j = random() % shape.n;
+        uint32_t zeroPointA = 0;
+        uint32_t zeroPointB = 0;
+        if (epilogue.zeroPoints != GemmZeroPoints::None) {
+            zeroPointA = static_cast<uint32_t>(parameters.zeroPointA);
+            zeroPointB = static_cast<uint32_t>(
+                epilogue.zeroPoints == GemmZeroPoints::PerColumn ? zeroPointsB[j] : parameters.zeroPointB);
+        }
+        uint32_t value = 0;
+        for (uint64_t k = 0; k < shape.k; ++k) {
+            value += (ReadIntegerComponent(a, property.AType, entry * strides.a + i + k * shape.m) - zeroPointA) *
+                (ReadIntegerComponent(b, property.BType, entry * strides.b + k + j * shape.k) - zeroPointB);
+        }
+        if (epilogue.bias) {
+            value += ReadIntegerComponent(bias, property.ResultType, j);
+        }
+        uint32_t expected = ApplyEpilogue(value, signedResult, epilogue, parameters) & outputMask;
+        uint32_t actual = ReadIntegerComponent(c, outputType, entry * strides.c + i + j * shape.m) & outputMask;
+        if (actual != expected) {
+            return false;
+        }
+    }
+    return true;
+}
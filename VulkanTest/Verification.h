@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef VERIFICATION_H_
+#define VERIFICATION_H_
+
+#include "GemmKernel.h"
+
+// Fills count elements of the given component type with values drawn from seed. Integer types cover
+// their whole range, float types are uniform in [-1, 1].
+void FillRandomComponents(void* data, VkComponentTypeKHR componentType, uint64_t count, uint64_t seed);
+
+// Expands elementCount elements of B packed by PackInt4Weights() into the float16 values a kernel with
+// GemmKernelConfig::int4GroupSize multiplies: every weight times the scale of its group of groupSize elements,
+// rounded to float16. Results checked against the expanded B only differ by the rounding of the device.
+void DequantizeInt4Weights(
+    const uint8_t* packed, const float* scales, uint64_t elementCount, uint32_t groupSize, uint16_t* b);
+
+// Copies a packed batch of row-major rows x columns matrices with elementSize-byte elements to column major, the
+// order the checks below take, so that kernels with row-major operands can be verified too.
+void TransposeToColumnMajor(
+    const void* rowMajor, uint32_t rows, uint32_t columns, uint32_t batch, uint32_t elementSize,
+    void* columnMajor);
+
+// Checks C = A * B for column-major A (MxK), B (KxN) and C (MxN) with Freivalds' algorithm: each trial
+// compares C * r with A * (B * r) for a random vector r, which costs O(MK + KN + MN) instead of O(MNK).
+// Integer results are compared exactly modulo the prime 2^61 - 1, so a wrong result passes a trial with
+// probability at most 1 / (2^61 - 1). When K is large enough for the 32-bit accumulators to wrap, they are
+// compared modulo 2^32 instead, and a wrong result passes a trial with probability at most 1/2. Float
+// results are compared against an error bound scaled by |A| * (|B| * |r|). Every entry of a packed batch is
+// checked.
+bool VerifyGemmFreivalds(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape,
+    const void* a, const void* b, const void* c, uint32_t trials, uint64_t seed);
+
+// Checks sampleCount random elements of a packed batch computed by a kernel with a fused epilogue, which is not
+// linear, so Freivalds' algorithm does not apply. Each element is recomputed as a dot product modulo 2^32
+// followed by the epilogue steps exactly as compute_nv.comp performs them, and has to match bit for bit.
+// Zero points are subtracted from A and B directly rather than through row and column sums. Integer accumulators
+// only; bias holds N accumulators and zeroPointsB N int32 values, each ignored unless the epilogue uses it.
+bool VerifyGemmEpilogueSamples(
+    const VkCooperativeMatrixPropertiesKHR& property, const GemmShape& shape, const GemmEpilogue& epilogue,
+    const GemmEpilogueParameters& parameters, const void* a, const void* b, const void* bias,
+    const int32_t* zeroPointsB, const void* c, uint32_t sampleCount, uint64_t seed);
+
+#endif
@@ -1,9 +1,32 @@
 #include "VulkanHelper.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
 namespace {
+    // The runtime staging ring: four 8 MB segments.
+    constexpr VkDeviceSize kStagingSegmentSize = 8ull * 1024 * 1024;
+    constexpr uint32_t kStagingSegmentCount = 4;
+
+    // Header of the files written by VulkanPipelineCache::Save(). It is followed by variantCount keys, each
+    // a uint32_t length and its characters, and then dataSize bytes of vkGetPipelineCacheData() output.
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint32_t variantCount;
+        uint64_t dataSize;
+    };
+    constexpr uint32_t kPipelineCacheFileMagic = 0x43505456;  // "VTPC"
+    constexpr uint32_t kPipelineCacheFileVersion = 1;
+
     std::string FormatDriverVersion(uint32_t vendorID, uint32_t driverVersion) {
         std::ostringstream stream;
         stream << driverVersion << "(";
@@ -20,23 +43,53 @@ namespace {
         return stream.str();
     }
 
-    const char* GetCooperativeMatrixTypeString(VkComponentTypeKHR componentType) {
-        switch (componentType) {
-            case VK_COMPONENT_TYPE_FLOAT16_KHR:
-                return "f16";
-            case VK_COMPONENT_TYPE_FLOAT32_KHR:
-                return "f32";
-            case VK_COMPONENT_TYPE_SINT8_KHR:
-                return "s8";
-            case VK_COMPONENT_TYPE_UINT8_KHR:
-                return "u8";
-            case VK_COMPONENT_TYPE_UINT32_KHR:
-                return "u32";
-            case VK_COMPONENT_TYPE_SINT32_KHR:
-                return "s32";
-            default:
-                return "";
+    bool HasDeviceExtension(VkPhysicalDevice physicalDevice, const char* extensionName) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+        for (const VkExtensionProperties& extension : extensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // SMs, CUs or shader cores from the vendor extension that reports them, or 0.
+    uint32_t QueryComputeUnitCount(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceShaderSMBuiltinsPropertiesNV smProperties = {};
+        smProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_SM_BUILTINS_PROPERTIES_NV;
+        VkPhysicalDeviceShaderCorePropertiesAMD coreProperties = {};
+        coreProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CORE_PROPERTIES_AMD;
+        VkPhysicalDeviceShaderCoreBuiltinsPropertiesARM coreBuiltinsProperties = {};
+        coreBuiltinsProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CORE_BUILTINS_PROPERTIES_ARM;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        if (HasDeviceExtension(physicalDevice, VK_NV_SHADER_SM_BUILTINS_EXTENSION_NAME)) {
+            smProperties.pNext = properties2.pNext;
+            properties2.pNext = &smProperties;
+        }
+        if (HasDeviceExtension(physicalDevice, VK_AMD_SHADER_CORE_PROPERTIES_EXTENSION_NAME)) {
+            coreProperties.pNext = properties2.pNext;
+            properties2.pNext = &coreProperties;
+        }
+        if (HasDeviceExtension(physicalDevice, VK_ARM_SHADER_CORE_BUILTINS_EXTENSION_NAME)) {
+            coreBuiltinsProperties.pNext = properties2.pNext;
+            properties2.pNext = &coreBuiltinsProperties;
+        }
+        if (properties2.pNext == nullptr) {
+            return 0;
         }
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        if (smProperties.shaderSMCount != 0) {
+            return smProperties.shaderSMCount;
+        }
+        if (coreProperties.computeUnitsPerShaderArray != 0) {
+            return coreProperties.shaderEngineCount * coreProperties.shaderArraysPerEngineCount *
+                coreProperties.computeUnitsPerShaderArray;
+        }
+        return coreBuiltinsProperties.shaderCoreCount;
     }
 }  // anonymous namespace
 
@@ -108,22 +161,398 @@ void RecordBufferBarrier(
         commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
 }
 
+void RecordBufferOwnershipTransfer(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkPipelineStageFlagBits srcStage,
+    VkPipelineStageFlagBits dstStage,
+    VkAccessFlags srcAccessMask,
+    VkAccessFlags dstAccessMask,
+    uint32_t srcQueueFamilyIndex,
+    uint32_t dstQueueFamilyIndex) {
+    VkBufferMemoryBarrier bufferMemoryBarrier = {};
+    bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferMemoryBarrier.srcAccessMask = srcAccessMask;
+    bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+    bufferMemoryBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+    bufferMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+    bufferMemoryBarrier.buffer = buffer;
+    bufferMemoryBarrier.offset = 0;
+    bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(
+        commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+}
+
+const char* GetCooperativeMatrixTypeString(VkComponentTypeKHR componentType) {
+    switch (componentType) {
+        case VK_COMPONENT_TYPE_FLOAT16_KHR:
+            return "f16";
+        case VK_COMPONENT_TYPE_FLOAT32_KHR:
+            return "f32";
+        case VK_COMPONENT_TYPE_SINT8_KHR:
+            return "s8";
+        case VK_COMPONENT_TYPE_UINT8_KHR:
+            return "u8";
+        case VK_COMPONENT_TYPE_UINT32_KHR:
+            return "u32";
+        case VK_COMPONENT_TYPE_SINT32_KHR:
+            return "s32";
+        default:
+            return "";
+    }
+}
+
+std::string GetCooperativeMatrixTypeName(const VkCooperativeMatrixPropertiesKHR& property) {
+    std::ostringstream stream;
+    stream << GetCooperativeMatrixTypeString(property.AType) << "_"
+        << GetCooperativeMatrixTypeString(property.BType) << "_"
+        << GetCooperativeMatrixTypeString(property.CType) << "_"
+        << GetCooperativeMatrixTypeString(property.ResultType);
+    return stream.str();
+}
+
 void PrintCooperativeMatrixProperty(VkCooperativeMatrixPropertiesKHR property) {
-    printf("AType: %s BType: %s CType: %s M: %d N: %d K: %d\n",
+    printf("AType: %s BType: %s CType: %s ResultType: %s M: %d N: %d K: %d%s\n",
         GetCooperativeMatrixTypeString(property.AType),
         GetCooperativeMatrixTypeString(property.BType),
         GetCooperativeMatrixTypeString(property.CType),
-        property.MSize, property.NSize, property.KSize);
+        GetCooperativeMatrixTypeString(property.ResultType),
+        property.MSize, property.NSize, property.KSize,
+        property.saturatingAccumulation ? " saturating" : "");
+}
+
+uint32_t GetComponentTypeSize(VkComponentTypeKHR componentType) {
+    switch (componentType) {
+        case VK_COMPONENT_TYPE_SINT8_KHR:
+        case VK_COMPONENT_TYPE_UINT8_KHR:
+            return 1;
+        case VK_COMPONENT_TYPE_FLOAT16_KHR:
+        case VK_COMPONENT_TYPE_SINT16_KHR:
+        case VK_COMPONENT_TYPE_UINT16_KHR:
+            return 2;
+        case VK_COMPONENT_TYPE_FLOAT32_KHR:
+        case VK_COMPONENT_TYPE_SINT32_KHR:
+        case VK_COMPONENT_TYPE_UINT32_KHR:
+            return 4;
+        case VK_COMPONENT_TYPE_FLOAT64_KHR:
+        case VK_COMPONENT_TYPE_SINT64_KHR:
+        case VK_COMPONENT_TYPE_UINT64_KHR:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+bool IsFloatComponentType(VkComponentTypeKHR componentType) {
+    return componentType == VK_COMPONENT_TYPE_FLOAT16_KHR || componentType == VK_COMPONENT_TYPE_FLOAT32_KHR ||
+        componentType == VK_COMPONENT_TYPE_FLOAT64_KHR;
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1F) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (halfExponent <= 0) {
+        // Subnormal half, or zero if the value is too small to be represented.
+        if (halfExponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1) != 0)) {
+            ++halfMantissa;
+        }
+        return static_cast<uint16_t>(sign | halfMantissa);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) {
+        // May carry into the exponent, which correctly rounds up to the next binade or infinity.
+        ++half;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float HalfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign != 0 ? -magnitude : magnitude;
+    }
+    uint32_t floatExponent = exponent == 0x1F ? 0xFF : exponent + 127 - 15;
+    uint32_t bits = sign | (floatExponent << 23) | (mantissa << 13);
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void WriteComponent(void* data, VkComponentTypeKHR componentType, size_t index, double value) {
+    switch (componentType) {
+        case VK_COMPONENT_TYPE_FLOAT16_KHR:
+            static_cast<uint16_t*>(data)[index] = FloatToHalf(static_cast<float>(value));
+            break;
+        case VK_COMPONENT_TYPE_FLOAT32_KHR:
+            static_cast<float*>(data)[index] = static_cast<float>(value);
+            break;
+        case VK_COMPONENT_TYPE_FLOAT64_KHR:
+            static_cast<double*>(data)[index] = value;
+            break;
+        case VK_COMPONENT_TYPE_SINT8_KHR:
+            static_cast<int8_t*>(data)[index] = static_cast<int8_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_UINT8_KHR:
+            static_cast<uint8_t*>(data)[index] = static_cast<uint8_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_SINT16_KHR:
+            static_cast<int16_t*>(data)[index] = static_cast<int16_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_UINT16_KHR:
+            static_cast<uint16_t*>(data)[index] = static_cast<uint16_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_SINT32_KHR:
+            static_cast<int32_t*>(data)[index] = static_cast<int32_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_UINT32_KHR:
+            static_cast<uint32_t*>(data)[index] = static_cast<uint32_t>(static_cast<int64_t>(value));
+            break;
+        case VK_COMPONENT_TYPE_SINT64_KHR:
+            static_cast<int64_t*>(data)[index] = static_cast<int64_t>(value);
+            break;
+        case VK_COMPONENT_TYPE_UINT64_KHR:
+            static_cast<uint64_t*>(data)[index] = static_cast<uint64_t>(value);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+double ReadComponent(const void* data, VkComponentTypeKHR componentType, size_t index) {
+    switch (componentType) {
+        case VK_COMPONENT_TYPE_FLOAT16_KHR:
+            return HalfToFloat(static_cast<const uint16_t*>(data)[index]);
+        case VK_COMPONENT_TYPE_FLOAT32_KHR:
+            return static_cast<const float*>(data)[index];
+        case VK_COMPONENT_TYPE_FLOAT64_KHR:
+            return static_cast<const double*>(data)[index];
+        case VK_COMPONENT_TYPE_SINT8_KHR:
+            return static_cast<const int8_t*>(data)[index];
+        case VK_COMPONENT_TYPE_UINT8_KHR:
+            return static_cast<const uint8_t*>(data)[index];
+        case VK_COMPONENT_TYPE_SINT16_KHR:
+            return static_cast<const int16_t*>(data)[index];
+        case VK_COMPONENT_TYPE_UINT16_KHR:
+            return static_cast<const uint16_t*>(data)[index];
+        case VK_COMPONENT_TYPE_SINT32_KHR:
+            return static_cast<const int32_t*>(data)[index];
+        case VK_COMPONENT_TYPE_UINT32_KHR:
+            return static_cast<const uint32_t*>(data)[index];
+        case VK_COMPONENT_TYPE_SINT64_KHR:
+            return static_cast<double>(static_cast<const int64_t*>(data)[index]);
+        case VK_COMPONENT_TYPE_UINT64_KHR:
+            return static_cast<double>(static_cast<const uint64_t*>(data)[index]);
+        default:
+            assert(false);
+            return 0.0;
+    }
+}
+
+// VulkanMemoryAllocator
+
+namespace {
+    VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}  // anonymous namespace
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(const VulkanRuntime& vulkanRuntime)
+    : mVulkanRuntime(vulkanRuntime),
+      mDevice(vulkanRuntime.GetLogicalDevice()) {
+    vkGetPhysicalDeviceMemoryProperties(vulkanRuntime.GetPhysicalDevice(), &mMemoryProperties);
+    mNonCoherentAtomSize = std::max<VkDeviceSize>(
+        1, vulkanRuntime.GetPhysicalDeviceProperties().limits.nonCoherentAtomSize);
+    mBlocks.resize(mMemoryProperties.memoryTypeCount);
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator() {
+    for (std::vector<Block>& blocks : mBlocks) {
+        for (Block& block : blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                vkFreeMemory(mDevice, block.memory, nullptr);
+            }
+        }
+    }
+}
+
+VulkanAllocation VulkanMemoryAllocator::Allocate(
+    const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memoryFlagBits) {
+    auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    VulkanAllocation allocation;
+    allocation.memoryTypeIndex = mVulkanRuntime.GetMemoryType(requirements.memoryTypeBits, memoryFlagBits);
+    VkMemoryPropertyFlags propertyFlags = mMemoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+    allocation.hostCoherent = (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    // Ranges of non-coherent memory are flushed and invalidated whole, so they must not share an atom.
+    VkDeviceSize alignment = std::max<VkDeviceSize>(1, requirements.alignment);
+    VkDeviceSize size = requirements.size;
+    if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && !allocation.hostCoherent) {
+        alignment = std::max(alignment, mNonCoherentAtomSize);
+        size = AlignUp(size, mNonCoherentAtomSize);
+    }
+    allocation.size = size;
+
+    std::vector<Block>& blocks = mBlocks[allocation.memoryTypeIndex];
+    bool found = false;
+    if (size <= kBlockSize / 2) {
+        for (uint32_t i = 0; i < blocks.size() && !found; ++i) {
+            if (!blocks[i].dedicated && blocks[i].memory != VK_NULL_HANDLE &&
+                AllocateFromBlock(blocks[i], size, alignment, &allocation.offset)) {
+                allocation.blockIndex = i;
+                found = true;
+            }
+        }
+        if (!found) {
+            allocation.blockIndex = CreateBlock(allocation.memoryTypeIndex, kBlockSize, false);
+            found = AllocateFromBlock(blocks[allocation.blockIndex], size, alignment, &allocation.offset);
+        }
+    } else {
+        allocation.blockIndex = CreateBlock(allocation.memoryTypeIndex, size, true);
+        allocation.offset = 0;
+        found = true;
+    }
+    assert(found);
+
+    const Block& block = blocks[allocation.blockIndex];
+    allocation.memory = block.memory;
+    if (block.mappedData != nullptr) {
+        allocation.mappedData = static_cast<uint8_t*>(block.mappedData) + allocation.offset;
+    }
+
+    ++mStatistics.allocationCount;
+    mStatistics.allocatedBytes += size;
+    ++mStatistics.totalAllocations;
+    mStatistics.allocationNanoseconds +=
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return allocation;
+}
+
+void VulkanMemoryAllocator::Free(const VulkanAllocation& allocation) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Block& block = mBlocks[allocation.memoryTypeIndex][allocation.blockIndex];
+    --mStatistics.allocationCount;
+    mStatistics.allocatedBytes -= allocation.size;
+
+    if (block.dedicated) {
+        vkFreeMemory(mDevice, block.memory, nullptr);
+        --mStatistics.deviceMemoryCount;
+        mStatistics.deviceMemoryBytes -= block.size;
+        block = Block();
+        return;
+    }
+
+    auto inserted = block.freeRanges.emplace(allocation.offset, allocation.size).first;
+    auto next = std::next(inserted);
+    if (next != block.freeRanges.end() && inserted->first + inserted->second == next->first) {
+        inserted->second += next->second;
+        block.freeRanges.erase(next);
+    }
+    if (inserted != block.freeRanges.begin()) {
+        auto previous = std::prev(inserted);
+        if (previous->first + previous->second == inserted->first) {
+            previous->second += inserted->second;
+            block.freeRanges.erase(inserted);
+        }
+    }
+}
+
+VulkanMemoryStatistics VulkanMemoryAllocator::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+bool VulkanMemoryAllocator::AllocateFromBlock(
+    Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset) {
+    for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range) {
+        VkDeviceSize rangeBegin = range->first;
+        VkDeviceSize rangeEnd = range->first + range->second;
+        VkDeviceSize alignedOffset = AlignUp(rangeBegin, alignment);
+        if (alignedOffset + size > rangeEnd) {
+            continue;
+        }
+        block.freeRanges.erase(range);
+        if (alignedOffset > rangeBegin) {
+            block.freeRanges.emplace(rangeBegin, alignedOffset - rangeBegin);
+        }
+        if (alignedOffset + size < rangeEnd) {
+            block.freeRanges.emplace(alignedOffset + size, rangeEnd - alignedOffset - size);
+        }
+        *offset = alignedOffset;
+        return true;
+    }
+    return false;
+}
+
+uint32_t VulkanMemoryAllocator::CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated) {
+    Block block;
+    block.size = size;
+    block.dedicated = dedicated;
+    VkMemoryAllocateInfo memoryAllocateInfo = {};
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+    // The device always enables bufferDeviceAddress, so any buffer may ask for its address.
+    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo = {};
+    memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+    memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
+    VK_CHECK_RESULT(vkAllocateMemory(mDevice, &memoryAllocateInfo, nullptr, &block.memory));
+    if ((mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+        VK_CHECK_RESULT(vkMapMemory(mDevice, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mappedData));
+    }
+    if (!dedicated) {
+        block.freeRanges.emplace(0, size);
+    }
+    ++mStatistics.deviceMemoryCount;
+    mStatistics.deviceMemoryBytes += size;
+    ++mStatistics.totalDeviceMemoryAllocations;
+
+    // Reuse the slot of a released dedicated block before growing the list.
+    std::vector<Block>& blocks = mBlocks[memoryTypeIndex];
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].memory == VK_NULL_HANDLE) {
+            blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(blocks.size() - 1);
 }
 
 // VulkanBuffer
 
 VulkanBuffer::VulkanBuffer(
-    const VulkanRuntime& vulkanRuntime,
+    VulkanRuntime& vulkanRuntime,
     VkDeviceSize size,
     VkBufferUsageFlags usageBits,
     VkMemoryPropertyFlags memoryFlagBits)
-    : mDevice(vulkanRuntime.GetLogicalDevice()) {
+    : mDevice(vulkanRuntime.GetLogicalDevice()),
+      mAllocator(&vulkanRuntime.GetMemoryAllocator()) {
     VkBufferCreateInfo bufferDesc = {};
     bufferDesc.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferDesc.usage = usageBits;
@@ -137,26 +566,62 @@ VulkanBuffer::VulkanBuffer(
 
     VkMemoryRequirements bufferMemoryRequirements = {};
     vkGetBufferMemoryRequirements(mDevice, mBuffer, &bufferMemoryRequirements);
-    VkMemoryAllocateInfo bufferMemoryAllocateInfo = {};
-    bufferMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    bufferMemoryAllocateInfo.pNext = nullptr;
-    bufferMemoryAllocateInfo.allocationSize = bufferMemoryRequirements.size;
-    bufferMemoryAllocateInfo.memoryTypeIndex = vulkanRuntime.GetMemoryType(
-        bufferMemoryRequirements.memoryTypeBits, memoryFlagBits);
-    VK_CHECK_RESULT(vkAllocateMemory(mDevice, &bufferMemoryAllocateInfo, nullptr, &mMemory));
+    mAllocation = mAllocator->Allocate(bufferMemoryRequirements, memoryFlagBits);
+
+    VK_CHECK_RESULT(vkBindBufferMemory(mDevice, mBuffer, mAllocation.memory, mAllocation.offset));
+
+    mSize = bufferMemoryRequirements.size;
+
+    if ((usageBits & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0) {
+        VkBufferDeviceAddressInfo bufferDeviceAddressInfo = {};
+        bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        bufferDeviceAddressInfo.buffer = mBuffer;
+        mDeviceAddress = vkGetBufferDeviceAddress(mDevice, &bufferDeviceAddressInfo);
+    }
+}
 
-    vkBindBufferMemory(mDevice, mBuffer, mMemory, 0);
+VulkanBuffer::VulkanBuffer(VulkanBuffer&& other)
+    : mDevice(other.mDevice),
+      mAllocator(other.mAllocator),
+      mBuffer(other.mBuffer),
+      mAllocation(other.mAllocation),
+      mSize(other.mSize),
+      mDeviceAddress(other.mDeviceAddress) {
+    other.mBuffer = VK_NULL_HANDLE;
+    other.mAllocation = VulkanAllocation();
+    other.mDeviceAddress = 0;
+}
 
-    mSize = bufferMemoryAllocateInfo.allocationSize;
+VulkanBuffer& VulkanBuffer::operator=(VulkanBuffer&& other) {
+    if (this != &other) {
+        Release();
+        mDevice = other.mDevice;
+        mAllocator = other.mAllocator;
+        mBuffer = other.mBuffer;
+        mAllocation = other.mAllocation;
+        mSize = other.mSize;
+        mDeviceAddress = other.mDeviceAddress;
+        other.mBuffer = VK_NULL_HANDLE;
+        other.mAllocation = VulkanAllocation();
+        other.mDeviceAddress = 0;
+    }
+    return *this;
 }
 
 VulkanBuffer::~VulkanBuffer() {
+    Release();
+}
+
+void VulkanBuffer::Release() {
     if (mBuffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(mDevice, mBuffer, nullptr);
+        mBuffer = VK_NULL_HANDLE;
     }
-    if (mMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(mDevice, mMemory, nullptr);
+    if (mAllocation.memory != VK_NULL_HANDLE) {
+        mAllocator->Free(mAllocation);
+        mAllocation = VulkanAllocation();
     }
+    mDeviceAddress = 0;
 }
 
 VkBuffer VulkanBuffer::GetVkBuffer() const {
@@ -164,13 +629,346 @@ VkBuffer VulkanBuffer::GetVkBuffer() const {
 }
 
 VkDeviceMemory VulkanBuffer::GetVkDeviceMemory() const {
-    return mMemory;
+    return mAllocation.memory;
+}
+
+VkDeviceSize VulkanBuffer::GetOffset() const {
+    return mAllocation.offset;
 }
 
 VkDeviceSize VulkanBuffer::GetSize() const {
     return mSize;
 }
 
+VkDeviceAddress VulkanBuffer::GetDeviceAddress() const {
+    return mDeviceAddress;
+}
+
+void* VulkanBuffer::GetMappedData() const {
+    return mAllocation.mappedData;
+}
+
+void VulkanBuffer::FlushMappedData() const {
+    if (mAllocation.mappedData == nullptr || mAllocation.hostCoherent) {
+        return;
+    }
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = mAllocation.memory;
+    range.offset = mAllocation.offset;
+    range.size = mAllocation.size;
+    VK_CHECK_RESULT(vkFlushMappedMemoryRanges(mDevice, 1, &range));
+}
+
+void VulkanBuffer::InvalidateMappedData() const {
+    if (mAllocation.mappedData == nullptr || mAllocation.hostCoherent) {
+        return;
+    }
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = mAllocation.memory;
+    range.offset = mAllocation.offset;
+    range.size = mAllocation.size;
+    VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(mDevice, 1, &range));
+}
+
+void VulkanBuffer::FlushMappedData(VkDeviceSize offset, VkDeviceSize size) const {
+    if (mAllocation.mappedData == nullptr || mAllocation.hostCoherent) {
+        return;
+    }
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = mAllocation.memory;
+    range.offset = mAllocation.offset + offset;
+    // The allocation is padded to the atom size, so a range that ends at the end of the buffer may be
+    // extended to the end of the allocation.
+    range.size = offset + size >= mSize ? mAllocation.size - offset : size;
+    VK_CHECK_RESULT(vkFlushMappedMemoryRanges(mDevice, 1, &range));
+}
+
+// VulkanStagingRing
+
+VulkanStagingRing::VulkanStagingRing(VulkanRuntime& vulkanRuntime, VkDeviceSize segmentSize, uint32_t segmentCount)
+    : mVulkanRuntime(vulkanRuntime),
+      mBuffer(vulkanRuntime.CreateBuffer(
+          segmentSize * segmentCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)),
+      mSegmentSize(segmentSize),
+      mSegmentTickets(segmentCount) {
+    assert(mBuffer.GetMappedData() != nullptr);
+}
+
+VulkanStagingRing::~VulkanStagingRing() {
+    Wait();
+}
+
+void VulkanStagingRing::Upload(
+    const VulkanBuffer& dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, const FillFunction& fill) {
+    assert(dstOffset + size <= dstBuffer.GetSize());
+    uint8_t* mappedData = static_cast<uint8_t*>(mBuffer.GetMappedData());
+    for (VkDeviceSize offset = 0; offset < size; offset += mSegmentSize) {
+        VkDeviceSize chunkSize = std::min(mSegmentSize, size - offset);
+        uint32_t segmentIndex = mNextSegment;
+        mNextSegment = (mNextSegment + 1) % static_cast<uint32_t>(mSegmentTickets.size());
+        mVulkanRuntime.Wait(mSegmentTickets[segmentIndex]);
+
+        VkDeviceSize segmentOffset = segmentIndex * mSegmentSize;
+        fill(mappedData + segmentOffset, offset, chunkSize);
+        mBuffer.FlushMappedData(segmentOffset, mSegmentSize);
+
+        VkCommandBuffer commandBuffer = mVulkanRuntime.CreateAndBeginCommandBuffer();
+        VkBufferCopy bufferCopy = {};
+        bufferCopy.srcOffset = segmentOffset;
+        bufferCopy.dstOffset = dstOffset + offset;
+        bufferCopy.size = chunkSize;
+        vkCmdCopyBuffer(commandBuffer, mBuffer.GetVkBuffer(), dstBuffer.GetVkBuffer(), 1, &bufferCopy);
+        mSegmentTickets[segmentIndex] = mVulkanRuntime.SubmitAsync(commandBuffer);
+    }
+}
+
+void VulkanStagingRing::Upload(
+    const VulkanBuffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    Upload(dstBuffer, dstOffset, size, [bytes](void* dst, VkDeviceSize offset, VkDeviceSize chunkSize) {
+        memcpy(dst, bytes + offset, chunkSize);
+    });
+}
+
+void VulkanStagingRing::Wait() {
+    for (VulkanSubmitTicket ticket : mSegmentTickets) {
+        mVulkanRuntime.Wait(ticket);
+    }
+}
+
+VkDeviceSize VulkanStagingRing::GetSegmentSize() const {
+    return mSegmentSize;
+}
+
+uint32_t VulkanStagingRing::GetSegmentCount() const {
+    return static_cast<uint32_t>(mSegmentTickets.size());
+}
+
+// VulkanPipelineCache
+
+VulkanPipelineCache::VulkanPipelineCache(const VulkanRuntime& vulkanRuntime)
+    : mDevice(vulkanRuntime.GetLogicalDevice()),
+      mDeviceProperties(vulkanRuntime.GetPhysicalDeviceProperties()) {
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, nullptr, &mPipelineCache));
+}
+
+VulkanPipelineCache::~VulkanPipelineCache() {
+    vkDestroyPipelineCache(mDevice, mPipelineCache, nullptr);
+}
+
+bool VulkanPipelineCache::Load(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        return false;
+    }
+    PipelineCacheFileHeader header = {};
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != kPipelineCacheFileMagic || header.version != kPipelineCacheFileVersion) {
+        std::cerr << "Ignoring pipeline cache " << path << ": not a pipeline cache file" << std::endl;
+        return false;
+    }
+    if (header.vendorID != mDeviceProperties.vendorID || header.deviceID != mDeviceProperties.deviceID ||
+        header.driverVersion != mDeviceProperties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cerr << "Ignoring pipeline cache " << path << ": written for another device or driver" << std::endl;
+        return false;
+    }
+
+    // Lengths come from the file, so they are checked against the rest of it before anything is allocated.
+    stream.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(stream.tellg());
+    stream.seekg(sizeof(header), std::ios::beg);
+    auto getRemainingSize = [&stream, fileSize]() { return fileSize - static_cast<uint64_t>(stream.tellg()); };
+
+    std::set<std::string> variants;
+    for (uint32_t i = 0; i < header.variantCount; ++i) {
+        uint32_t length = 0;
+        if (!stream.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > getRemainingSize()) {
+            std::cerr << "Ignoring pipeline cache " << path << ": truncated" << std::endl;
+            return false;
+        }
+        std::string key(length, '\0');
+        if (!stream.read(&key[0], length)) {
+            std::cerr << "Ignoring pipeline cache " << path << ": truncated" << std::endl;
+            return false;
+        }
+        variants.insert(std::move(key));
+    }
+    if (header.dataSize > getRemainingSize()) {
+        std::cerr << "Ignoring pipeline cache " << path << ": truncated" << std::endl;
+        return false;
+    }
+    std::vector<char> data(header.dataSize);
+    if (!stream.read(data.data(), data.size())) {
+        std::cerr << "Ignoring pipeline cache " << path << ": truncated" << std::endl;
+        return false;
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.initialDataSize = data.size();
+    pipelineCacheCreateInfo.pInitialData = data.data();
+    VkPipelineCache loadedCache;
+    VK_CHECK_RESULT(vkCreatePipelineCache(mDevice, &pipelineCacheCreateInfo, nullptr, &loadedCache));
+    VK_CHECK_RESULT(vkMergePipelineCaches(mDevice, mPipelineCache, 1, &loadedCache));
+    vkDestroyPipelineCache(mDevice, loadedCache, nullptr);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mVariants.insert(variants.begin(), variants.end());
+    mStatistics.loadedVariants = static_cast<uint32_t>(variants.size());
+    return true;
+}
+
+bool VulkanPipelineCache::Save(const std::string& path) const {
+    size_t dataSize = 0;
+    VK_CHECK_RESULT(vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr));
+    std::vector<char> data(dataSize);
+    VK_CHECK_RESULT(vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, data.data()));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    PipelineCacheFileHeader header = {};
+    header.magic = kPipelineCacheFileMagic;
+    header.version = kPipelineCacheFileVersion;
+    header.vendorID = mDeviceProperties.vendorID;
+    header.deviceID = mDeviceProperties.deviceID;
+    header.driverVersion = mDeviceProperties.driverVersion;
+    memcpy(header.pipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.variantCount = static_cast<uint32_t>(mVariants.size());
+    header.dataSize = dataSize;
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+        return false;
+    }
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const std::string& key : mVariants) {
+        uint32_t length = static_cast<uint32_t>(key.size());
+        stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        stream.write(key.data(), length);
+    }
+    stream.write(data.data(), dataSize);
+    return stream.good();
+}
+
+VkPipeline VulkanPipelineCache::CreateComputePipeline(
+    const VkComputePipelineCreateInfo& createInfo, const std::string& key) {
+    bool known = HasVariant(key);
+    auto start = std::chrono::steady_clock::now();
+    VkPipeline pipeline;
+    VK_CHECK_RESULT(vkCreateComputePipelines(mDevice, mPipelineCache, 1, &createInfo, nullptr, &pipeline));
+    double nanoseconds =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mVariants.insert(key);
+    if (known) {
+        ++mStatistics.hits;
+        mStatistics.hitNanoseconds += nanoseconds;
+    } else {
+        ++mStatistics.misses;
+        mStatistics.missNanoseconds += nanoseconds;
+    }
+    return pipeline;
+}
+
+bool VulkanPipelineCache::HasVariant(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mVariants.count(key) != 0;
+}
+
+VkPipelineCache VulkanPipelineCache::GetVkPipelineCache() const {
+    return mPipelineCache;
+}
+
+VulkanPipelineCacheStatistics VulkanPipelineCache::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
+// VulkanProfiler
+
+VulkanProfiler::VulkanProfiler(const VulkanRuntime& vulkanRuntime, uint32_t maxRegions)
+    : mDevice(vulkanRuntime.GetLogicalDevice()),
+      mMaxRegions(maxRegions) {
+    const VkPhysicalDeviceLimits& limits = vulkanRuntime.GetPhysicalDeviceProperties().limits;
+    uint32_t validBits = vulkanRuntime.GetTimestampValidBits();
+    mTimestampPeriod = limits.timestampPeriod;
+    mTimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    if (!IsSupported()) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = 2 * mMaxRegions;
+    VK_CHECK_RESULT(vkCreateQueryPool(mDevice, &queryPoolCreateInfo, nullptr, &mQueryPool));
+}
+
+VulkanProfiler::~VulkanProfiler() {
+    if (mQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+    }
+}
+
+bool VulkanProfiler::IsSupported() const {
+    return mTimestampMask != 0 && mTimestampPeriod > 0.0;
+}
+
+void VulkanProfiler::Reset(VkCommandBuffer commandBuffer) {
+    mRegionNames.clear();
+    mOpenRegions.clear();
+    if (mQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, mQueryPool, 0, 2 * mMaxRegions);
+    }
+}
+
+void VulkanProfiler::BeginRegion(VkCommandBuffer commandBuffer, const char* name, VkPipelineStageFlagBits stage) {
+    assert(mRegionNames.size() < mMaxRegions);
+    uint32_t region = static_cast<uint32_t>(mRegionNames.size());
+    mRegionNames.push_back(name);
+    mOpenRegions.push_back(region);
+    if (mQueryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, stage, mQueryPool, 2 * region);
+    }
+}
+
+void VulkanProfiler::EndRegion(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage) {
+    assert(!mOpenRegions.empty());
+    uint32_t region = mOpenRegions.back();
+    mOpenRegions.pop_back();
+    if (mQueryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, stage, mQueryPool, 2 * region + 1);
+    }
+}
+
+std::vector<VulkanProfilerRegion> VulkanProfiler::GetResults() const {
+    assert(mOpenRegions.empty());
+    std::vector<VulkanProfilerRegion> results(mRegionNames.size());
+    for (size_t i = 0; i < mRegionNames.size(); ++i) {
+        results[i].name = mRegionNames[i];
+    }
+    if (mQueryPool == VK_NULL_HANDLE || mRegionNames.empty()) {
+        return results;
+    }
+
+    std::vector<uint64_t> timestamps(2 * mRegionNames.size());
+    VK_CHECK_RESULT(vkGetQueryPoolResults(
+        mDevice, mQueryPool, 0, static_cast<uint32_t>(timestamps.size()),
+        timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    for (size_t i = 0; i < results.size(); ++i) {
+        uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & mTimestampMask;
+        results[i].nanoseconds = static_cast<double>(ticks) * mTimestampPeriod;
+    }
+    return results;
+}
+
 // VulkanSwapchain
 
 VulkanSwapchain::VulkanSwapchain(
@@ -364,7 +1162,96 @@ VkFormat VulkanSwapchain::GetSwapchainFormat() const {
 
 // VulkanRuntime
 
+std::unique_ptr<VulkanRuntime> VulkanRuntime::Create() {
+    std::unique_ptr<VulkanRuntime> vulkanRuntime(new VulkanRuntime());
+    if (!vulkanRuntime->CreateInstance({ VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME })) {
+        return nullptr;
+    }
+    if (!vulkanRuntime->InitializeHeadless()) {
+        vkDestroyInstance(vulkanRuntime->mInstance, nullptr);
+        return nullptr;
+    }
+    return vulkanRuntime;
+}
+
+VulkanRuntime::VulkanRuntime() {}
+
+bool VulkanRuntime::InitializeHeadless() {
+    const std::vector<const char*> deviceExtensions = { VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME };
+    if (!PickPhysicalDevice(deviceExtensions)) {
+        return false;
+    }
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
+    assert(queueFamilyCount > 0);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    // Prefer a compute-only family, which does not share its queues with graphics work, as long as it
+    // supports timestamps; otherwise take the first compute-capable family.
+    mQueueFamilyIndex = queueFamilyCount;
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+        VkQueueFlags queueFlags = queueFamilyProperties[i].queueFlags;
+        if ((queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) {
+            continue;
+        }
+        bool computeOnly = (queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0 && queueFamilyProperties[i].timestampValidBits != 0;
+        if (mQueueFamilyIndex == queueFamilyCount || computeOnly) {
+            mQueueFamilyIndex = i;
+        }
+        if (computeOnly) {
+            break;
+        }
+    }
+    if (mQueueFamilyIndex == queueFamilyCount) {
+        std::cerr << "Cannot find a compute-capable queue family!" << std::endl;
+        return false;
+    }
+
+    return CreateDevice(deviceExtensions);
+}
+
+#ifdef _WIN32
 VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
+    const std::vector<const char*> deviceExtensions = {
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME
+    };
+    if (!CreateInstance({
+            VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+            VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+        }) || !PickPhysicalDevice(deviceExtensions)) {
+        exit(1);
+    }
+
+    VkWin32SurfaceCreateInfoKHR createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+    createInfo.hwnd = hwnd;
+    createInfo.hinstance = GetModuleHandle(nullptr);
+    VK_CHECK_RESULT(vkCreateWin32SurfaceKHR(mInstance, &createInfo, nullptr, &mSurface));
+
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
+    assert(queueFamilyCount > 0);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    std::vector<VkBool32> supportsPresent(queueFamilyCount);
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(mPhysicalDevice, i, mSurface, &supportsPresent[i]);
+    }
+    for (mQueueFamilyIndex = 0; mQueueFamilyIndex < static_cast<uint32_t>(queueFamilyProperties.size()); mQueueFamilyIndex++) {
+        if ((queueFamilyProperties[mQueueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0 &&
+            supportsPresent[mQueueFamilyIndex]) {
+            break;
+        }
+    }
+
+    if (!CreateDevice(deviceExtensions)) {
+        exit(1);
+    }
+}
+#endif
+
+bool VulkanRuntime::CreateInstance(const std::vector<const char*>& instanceExtensions) {
     const char* kAppName = "Vulkan Application";
     constexpr uint32_t kAPIVersion = VK_API_VERSION_1_3;
 
@@ -377,11 +1264,8 @@ VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     instanceCreateInfo.pApplicationInfo = &applicationInfo;
-    const char* instanceExtensions[] = {
-        VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
-    };
-    instanceCreateInfo.enabledExtensionCount = ARRAYSIZE(instanceExtensions);
-    instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions;
+    instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+    instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
     if (vkCreateInstance(&instanceCreateInfo, nullptr, &mInstance) != VK_SUCCESS) {
         std::cerr << "Failed to create Vulkan instance!" << std::endl
             << "Minimum Vulkan version required: 1.3" << std::endl
@@ -389,22 +1273,45 @@ VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
         for (const char* requiredExtensionName : instanceExtensions) {
             std::cerr << "  " << requiredExtensionName << std::endl;
         }
-        exit(1);
+        return false;
     }
+    return true;
+}
 
+bool VulkanRuntime::PickPhysicalDevice(const std::vector<const char*>& deviceExtensions) {
     uint32_t gpuCount = 0;
     VK_CHECK_RESULT(vkEnumeratePhysicalDevices(mInstance, &gpuCount, nullptr));
-    assert(gpuCount > 0);
+    if (gpuCount == 0) {
+        std::cerr << "Cannot find Vulkan physical device!" << std::endl;
+        return false;
+    }
 
-    std::vector<VkPhysicalDevice> physicalDevices(gpuCount);
-    VK_CHECK_RESULT(vkEnumeratePhysicalDevices(mInstance, &gpuCount, physicalDevices.data()));
-    VkPhysicalDevice chosenGPU = VK_NULL_HANDLE;
-    for (VkPhysicalDevice physicalDevice : physicalDevices) {
+    std::vector<VkPhysicalDevice> allPhysicalDevices(gpuCount);
+    VK_CHECK_RESULT(vkEnumeratePhysicalDevices(mInstance, &gpuCount, allPhysicalDevices.data()));
+    // vkCreateDevice fails on an unsupported extension, so devices without all of them are not candidates.
+    std::vector<VkPhysicalDevice> physicalDevices;
+    for (VkPhysicalDevice physicalDevice : allPhysicalDevices) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
         std::vector<VkExtensionProperties> extensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+        auto isSupported = [&extensions](const char* name) {
+            return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) {
+                return strcmp(extension.extensionName, name) == 0;
+            });
+        };
+        if (std::all_of(deviceExtensions.begin(), deviceExtensions.end(), isSupported)) {
+            physicalDevices.push_back(physicalDevice);
+        }
+    }
+    if (physicalDevices.empty()) {
+        std::cerr << "Cannot find a Vulkan physical device with the required device extensions:" << std::endl;
+        for (const char* requiredExtensionName : deviceExtensions) {
+            std::cerr << "  " << requiredExtensionName << std::endl;
+        }
+        return false;
     }
+    VkPhysicalDevice chosenGPU = VK_NULL_HANDLE;
     if (chosenGPU == VK_NULL_HANDLE) {
         for (VkPhysicalDevice physicalDevice : physicalDevices) {
             VkPhysicalDeviceProperties physicalDeviceProperties;
@@ -418,47 +1325,55 @@ VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
                 chosenGPU = physicalDevice;
             }
         }
-    }  
+    }
+    // Software ICDs such as lavapipe report VK_PHYSICAL_DEVICE_TYPE_CPU, which is all a CI node may have.
     if (chosenGPU == VK_NULL_HANDLE) {
-        std::cerr << "Cannot find Vulkan physical device!" << std::endl;
-        exit(1);
+        chosenGPU = physicalDevices[0];
     }
     mPhysicalDevice = chosenGPU;
     vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &mPhysicalDeviceMemoryProperties);
 
+    mVulkan13Properties = {};
+    mVulkan13Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_PROPERTIES;
+    mVulkan11Properties = {};
+    mVulkan11Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES;
+    mVulkan11Properties.pNext = &mVulkan13Properties;
     mPhysicalDeviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    mPhysicalDeviceProperties2.pNext = &mVulkan11Properties;
     vkGetPhysicalDeviceProperties2(mPhysicalDevice, &mPhysicalDeviceProperties2);
+    mComputeUnitCount = QueryComputeUnitCount(mPhysicalDevice);
 
     std::cout << GetDeviceInfo() << std::endl;
+    return true;
+}
 
-    VkWin32SurfaceCreateInfoKHR createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-    createInfo.hwnd = hwnd;
-    createInfo.hinstance = GetModuleHandle(nullptr);
-    VK_CHECK_RESULT(vkCreateWin32SurfaceKHR(mInstance, &createInfo, nullptr, &mSurface));
-
+bool VulkanRuntime::CreateDevice(const std::vector<const char*>& deviceExtensions) {
     uint32_t queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
-    assert(queueFamilyCount > 0);
     std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilyProperties.data());
-    std::vector<VkBool32> supportsPresent(queueFamilyCount);
+
+    // Transfer-only families are backed by copy engines, so uploads and readbacks on them overlap with
+    // compute on the main queue.
+    uint32_t transferQueueFamilyIndex = mQueueFamilyIndex;
     for (uint32_t i = 0; i < queueFamilyCount; ++i) {
-        vkGetPhysicalDeviceSurfaceSupportKHR(mPhysicalDevice, i, mSurface, &supportsPresent[i]);
-    }
-    uint32_t queueFamilyIndex;
-    for (queueFamilyIndex = 0; queueFamilyIndex < static_cast<uint32_t>(queueFamilyProperties.size()); queueFamilyIndex++) {
-        if ((queueFamilyProperties[queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0 &&
-            supportsPresent[queueFamilyIndex]) {
+        VkQueueFlags queueFlags = queueFamilyProperties[i].queueFlags;
+        if (i != mQueueFamilyIndex && (queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+            (queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0) {
+            transferQueueFamilyIndex = i;
             break;
         }
     }
+    mDedicatedTransferQueue = transferQueueFamilyIndex != mQueueFamilyIndex;
+
     const float kQueuePriority = 0.f;
-    VkDeviceQueueCreateInfo queueCreateInfo = {};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    queueCreateInfo.queueCount = 1;
-    queueCreateInfo.pQueuePriorities = &kQueuePriority;
+    VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
+    queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfos[0].queueFamilyIndex = mQueueFamilyIndex;
+    queueCreateInfos[0].queueCount = 1;
+    queueCreateInfos[0].pQueuePriorities = &kQueuePriority;
+    queueCreateInfos[1] = queueCreateInfos[0];
+    queueCreateInfos[1].queueFamilyIndex = transferQueueFamilyIndex;
 
     VkPhysicalDeviceCooperativeMatrixFeaturesKHR coopMatFeatures = {
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_COOPERATIVE_MATRIX_FEATURES_KHR,
@@ -477,35 +1392,48 @@ VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
     vulkan12Features.vulkanMemoryModel = VK_TRUE;
     vulkan12Features.vulkanMemoryModelDeviceScope = VK_TRUE;
     vulkan12Features.storageBuffer8BitAccess = VK_TRUE;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+    supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures = {};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &supportedFeatures);
+    mDescriptorUpdateAfterBind = supportedVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = mDescriptorUpdateAfterBind ? VK_TRUE : VK_FALSE;
 
     VkPhysicalDeviceVulkan13Features vulkan13Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES, &vulkan12Features };
     vulkan13Features.maintenance4 = VK_TRUE;
-
-    std::vector<const char*> requiredDeviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        VK_KHR_COOPERATIVE_MATRIX_EXTENSION_NAME,
-    };
+    vulkan13Features.subgroupSizeControl = VK_TRUE;
+    vulkan13Features.computeFullSubgroups = VK_TRUE;
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
+    deviceCreateInfo.queueCreateInfoCount = mDedicatedTransferQueue ? 2 : 1;
+    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
     deviceCreateInfo.pNext = &vulkan13Features;
     if (vkCreateDevice(mPhysicalDevice, &deviceCreateInfo, nullptr, &mLogicalDevice) != VK_SUCCESS) {
         std::cerr << "Failed to create VkDevice!" << std::endl;
-        exit(1);
+        return false;
     }
 
-    VkCommandPoolCreateInfo commandPoolCreateInfo = {};
-    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
-    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    VK_CHECK_RESULT(
-        vkCreateCommandPool(mLogicalDevice, &commandPoolCreateInfo, nullptr, &mCommandPool));
+    mTimestampValidBits = queueFamilyProperties[mQueueFamilyIndex].timestampValidBits;
 
-    vkGetDeviceQueue(mLogicalDevice, queueFamilyIndex, 0, &mQueue);
+    vkGetDeviceQueue(mLogicalDevice, mQueueFamilyIndex, 0, &mQueue);
+    mSubmitQueues[static_cast<int>(VulkanQueueType::Compute)].queue = mQueue;
+    mSubmitQueues[static_cast<int>(VulkanQueueType::Compute)].familyIndex = mQueueFamilyIndex;
+    if (mDedicatedTransferQueue) {
+        SubmitQueue& transferQueue = mSubmitQueues[static_cast<int>(VulkanQueueType::Transfer)];
+        vkGetDeviceQueue(mLogicalDevice, transferQueueFamilyIndex, 0, &transferQueue.queue);
+        transferQueue.familyIndex = transferQueueFamilyIndex;
+    }
+    bool computeOnly = (queueFamilyProperties[mQueueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0;
+    std::cout << "Compute queue family: " << mQueueFamilyIndex << (computeOnly ? " (compute-only)" : "")
+              << ", transfer queue family: " << transferQueueFamilyIndex
+              << (mDedicatedTransferQueue ? " (transfer-only)" : " (shared)") << std::endl;
 
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -520,6 +1448,25 @@ VulkanRuntime::VulkanRuntime(HWND hwnd) : mHwnd(hwnd) {
     mSubmitInfo.waitSemaphoreCount = 1;
     mSubmitInfo.signalSemaphoreCount = 1;
     mSubmitInfo.pSignalSemaphores = &mRenderCompleteSemaphore;
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+    semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeCreateInfo.initialValue = 0;
+    semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+    // One timeline per queue: signal operations on a timeline must be ordered, which two queues cannot
+    // guarantee for a shared one.
+    for (SubmitQueue& submitQueue : mSubmitQueues) {
+        if (submitQueue.queue != VK_NULL_HANDLE) {
+            VK_CHECK_RESULT(
+                vkCreateSemaphore(mLogicalDevice, &semaphoreCreateInfo, nullptr, &submitQueue.timelineSemaphore));
+        }
+    }
+
+    mMemoryAllocator.reset(new VulkanMemoryAllocator(*this));
+    mStagingRing.reset(new VulkanStagingRing(*this, kStagingSegmentSize, kStagingSegmentCount));
+    mPipelineCache.reset(new VulkanPipelineCache(*this));
+    return true;
 }
 
 VulkanSwapchain VulkanRuntime::RecreateSwapchain(VulkanSwapchain* oldSwapchain) {
@@ -642,18 +1589,37 @@ std::string VulkanRuntime::GetDeviceInfo() const {
         << FormatDriverVersion(mPhysicalDeviceProperties2.properties.vendorID, 
                                mPhysicalDeviceProperties2.properties.driverVersion) << "\n"
         << "is_discrete_gpu: " << std::boolalpha 
-        << (mPhysicalDeviceProperties2.properties.deviceType == VkPhysicalDeviceType::VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) << "\n";
+        << (mPhysicalDeviceProperties2.properties.deviceType == VkPhysicalDeviceType::VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) << "\n"
+        << "compute_units: " << std::dec << mComputeUnitCount << "\n";
     return stream.str();
 }
 
-VkCommandBuffer VulkanRuntime::CreateAndBeginCommandBuffer() const {
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.commandPool = mCommandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-    VkCommandBuffer commandBuffer;
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(mLogicalDevice, &commandBufferAllocateInfo, &commandBuffer));
+VkCommandBuffer VulkanRuntime::CreateAndBeginCommandBuffer(VulkanQueueType queueType) const {
+    ThreadCommandPool* threadCommandPool = nullptr;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        RetireSubmissions();
+        threadCommandPool = GetThreadCommandPool(queueType);
+        if (!threadCommandPool->freeCommandBuffers.empty()) {
+            commandBuffer = threadCommandPool->freeCommandBuffers.back();
+            threadCommandPool->freeCommandBuffers.pop_back();
+        }
+    }
+
+    // Only this thread touches its pool, so it can be used without holding the lock.
+    if (commandBuffer != VK_NULL_HANDLE) {
+        VK_CHECK_RESULT(vkResetCommandBuffer(commandBuffer, 0));
+    } else {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandPool = threadCommandPool->commandPool;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(mLogicalDevice, &commandBufferAllocateInfo, &commandBuffer));
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        mCommandBufferPools[commandBuffer] = threadCommandPool;
+    }
 
     VkCommandBufferBeginInfo commandBufferBeginInfo = {};
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -663,26 +1629,184 @@ VkCommandBuffer VulkanRuntime::CreateAndBeginCommandBuffer() const {
 }
 
 void VulkanRuntime::EndAndFreeCommandBuffer(VkCommandBuffer commandBuffer) const {
-    vkEndCommandBuffer(commandBuffer);
+    Wait(SubmitAsync(commandBuffer));
+}
+
+void VulkanRuntime::FreeCommandBuffer(VkCommandBuffer commandBuffer) const {
+    VulkanSubmitTicket replayTicket;
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        auto replayValue = mReplayValues.find(commandBuffer);
+        if (replayValue != mReplayValues.end()) {
+            replayTicket.value = replayValue->second;
+            replayTicket.queueType = mCommandBufferPools.at(commandBuffer)->queueType;
+            mReplayValues.erase(replayValue);
+        }
+    }
+    Wait(replayTicket);
+    std::lock_guard<std::mutex> lock(mSubmitMutex);
+    mCommandBufferPools.at(commandBuffer)->freeCommandBuffers.push_back(commandBuffer);
+}
+
+VulkanSubmitTicket VulkanRuntime::SubmitAsync(
+    VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets) const {
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+    return Submit(commandBuffer, waitTickets, true);
+}
+
+void VulkanRuntime::EndReplayableCommandBuffer(VkCommandBuffer commandBuffer) const {
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+    std::lock_guard<std::mutex> lock(mSubmitMutex);
+    mReplayValues[commandBuffer] = 0;
+}
+
+VulkanSubmitTicket VulkanRuntime::Replay(
+    VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets) const {
+    VulkanSubmitTicket previousTicket;
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        previousTicket.value = mReplayValues.at(commandBuffer);
+        previousTicket.queueType = mCommandBufferPools.at(commandBuffer)->queueType;
+    }
+    Wait(previousTicket);
+    VulkanSubmitTicket ticket = Submit(commandBuffer, waitTickets, false);
+    std::lock_guard<std::mutex> lock(mSubmitMutex);
+    mReplayValues[commandBuffer] = ticket.value;
+    return ticket;
+}
+
+VulkanSubmitTicket VulkanRuntime::Submit(
+    VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets, bool recycle) const {
+    VulkanSubmitTicket oldestTicket;
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        RetireSubmissions();
+        oldestTicket.queueType = mCommandBufferPools.at(commandBuffer)->queueType;
+        SubmitQueue& submitQueue = GetSubmitQueue(oldestTicket.queueType);
+        if (submitQueue.inFlightSubmissions.size() >= kMaxInFlightSubmissions) {
+            oldestTicket.value = submitQueue.inFlightSubmissions.front().value;
+        }
+    }
+    Wait(oldestTicket);
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const VulkanSubmitTicket& waitTicket : waitTickets) {
+        if (waitTicket.value != 0) {
+            waitSemaphores.push_back(GetTimelineSemaphore(waitTicket.queueType));
+            waitValues.push_back(waitTicket.value);
+            waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mSubmitMutex);
+    SubmitQueue& submitQueue = GetSubmitQueue(oldestTicket.queueType);
+    VulkanSubmitTicket ticket;
+    ticket.value = ++submitQueue.lastSubmittedValue;
+    ticket.queueType = oldestTicket.queueType;
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineSubmitInfo.signalSemaphoreValueCount = 1;
+    timelineSubmitInfo.pSignalSemaphoreValues = &ticket.value;
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &submitQueue.timelineSemaphore;
+    VK_CHECK_RESULT(vkQueueSubmit(submitQueue.queue, 1, &submitInfo, VK_NULL_HANDLE));
+    submitQueue.inFlightSubmissions.push_back({ recycle ? commandBuffer : VK_NULL_HANDLE, ticket.value });
+    return ticket;
+}
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    VkFence fence;
-    VK_CHECK_RESULT(vkCreateFence(mLogicalDevice, &fenceInfo, nullptr, &fence));
-    VK_CHECK_RESULT(vkQueueSubmit(mQueue, 1, &submitInfo, fence));
-    constexpr uint64_t kFenceTimeoutInNS = 0xFFFFFFFFFFFFFFFF;
-    VK_CHECK_RESULT(vkWaitForFences(mLogicalDevice, 1, &fence, VK_TRUE, kFenceTimeoutInNS));
-    vkDestroyFence(mLogicalDevice, fence, nullptr);
+bool VulkanRuntime::IsComplete(VulkanSubmitTicket ticket) const {
+    uint64_t completedValue = 0;
+    VK_CHECK_RESULT(
+        vkGetSemaphoreCounterValue(mLogicalDevice, GetTimelineSemaphore(ticket.queueType), &completedValue));
+    return completedValue >= ticket.value;
+}
 
-    FreeCommandBuffer(commandBuffer);
+void VulkanRuntime::Wait(VulkanSubmitTicket ticket) const {
+    if (ticket.value == 0) {
+        return;
+    }
+    VkSemaphore timelineSemaphore = GetTimelineSemaphore(ticket.queueType);
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &ticket.value;
+    constexpr uint64_t kTimeoutInNS = 0xFFFFFFFFFFFFFFFF;
+    VK_CHECK_RESULT(vkWaitSemaphores(mLogicalDevice, &waitInfo, kTimeoutInNS));
 }
 
-void VulkanRuntime::FreeCommandBuffer(VkCommandBuffer commandBuffer) const {
-    vkFreeCommandBuffers(mLogicalDevice, mCommandPool, 1, &commandBuffer);
+void VulkanRuntime::WaitIdle() const {
+    VulkanSubmitTicket tickets[2];
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        tickets[0].value = GetSubmitQueue(VulkanQueueType::Compute).lastSubmittedValue;
+        tickets[1].value = GetSubmitQueue(VulkanQueueType::Transfer).lastSubmittedValue;
+        tickets[1].queueType = VulkanQueueType::Transfer;
+    }
+    Wait(tickets[0]);
+    Wait(tickets[1]);
+}
+
+VkSemaphore VulkanRuntime::GetTimelineSemaphore(VulkanQueueType queueType) const {
+    return GetSubmitQueue(queueType).timelineSemaphore;
+}
+
+VulkanRuntime::SubmitQueue& VulkanRuntime::GetSubmitQueue(VulkanQueueType queueType) const {
+    if (!mDedicatedTransferQueue) {
+        queueType = VulkanQueueType::Compute;
+    }
+    return mSubmitQueues[static_cast<int>(queueType)];
+}
+
+VulkanRuntime::ThreadCommandPool* VulkanRuntime::GetThreadCommandPool(VulkanQueueType queueType) const {
+    uint32_t queueFamilyIndex = GetSubmitQueue(queueType).familyIndex;
+    std::unique_ptr<ThreadCommandPool>& threadCommandPool =
+        mThreadCommandPools[{ std::this_thread::get_id(), queueFamilyIndex }];
+    if (!threadCommandPool) {
+        threadCommandPool = std::make_unique<ThreadCommandPool>();
+        threadCommandPool->queueType = mDedicatedTransferQueue ? queueType : VulkanQueueType::Compute;
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        VK_CHECK_RESULT(
+            vkCreateCommandPool(mLogicalDevice, &commandPoolCreateInfo, nullptr, &threadCommandPool->commandPool));
+    }
+    return threadCommandPool.get();
+}
+
+void VulkanRuntime::RetireSubmissions() const {
+    for (SubmitQueue& submitQueue : mSubmitQueues) {
+        if (submitQueue.inFlightSubmissions.empty()) {
+            continue;
+        }
+        uint64_t completedValue = 0;
+        VK_CHECK_RESULT(vkGetSemaphoreCounterValue(mLogicalDevice, submitQueue.timelineSemaphore, &completedValue));
+        while (!submitQueue.inFlightSubmissions.empty() &&
+               submitQueue.inFlightSubmissions.front().value <= completedValue) {
+            VkCommandBuffer commandBuffer = submitQueue.inFlightSubmissions.front().commandBuffer;
+            submitQueue.inFlightSubmissions.pop_front();
+            if (commandBuffer != VK_NULL_HANDLE) {
+                mCommandBufferPools.at(commandBuffer)->freeCommandBuffers.push_back(commandBuffer);
+            }
+        }
+    }
+}
+
+bool VulkanRuntime::SupportsDescriptorUpdateAfterBind() const {
+    return mDescriptorUpdateAfterBind;
 }
 
 void VulkanRuntime::QueueSubmit(const std::vector<VkCommandBuffer>& commandBuffers, VkSemaphore waitSemaphore) {
@@ -701,6 +1825,26 @@ VkQueue VulkanRuntime::GetQueue() const {
     return mQueue;
 }
 
+uint32_t VulkanRuntime::GetQueueFamilyIndex() const {
+    return mQueueFamilyIndex;
+}
+
+uint32_t VulkanRuntime::GetQueueFamilyIndex(VulkanQueueType queueType) const {
+    return GetSubmitQueue(queueType).familyIndex;
+}
+
+bool VulkanRuntime::HasDedicatedTransferQueue() const {
+    return mDedicatedTransferQueue;
+}
+
+uint32_t VulkanRuntime::GetTimestampValidBits() const {
+    return mTimestampValidBits;
+}
+
+uint32_t VulkanRuntime::GetComputeUnitCount() const {
+    return mComputeUnitCount;
+}
+
 VkPhysicalDevice VulkanRuntime::GetPhysicalDevice() const {
     return mPhysicalDevice;
 }
@@ -709,6 +1853,10 @@ VkSurfaceKHR VulkanRuntime::GetSurface() const {
     return mSurface;
 }
 
+bool VulkanRuntime::IsHeadless() const {
+    return mSurface == VK_NULL_HANDLE;
+}
+
 VkSemaphore VulkanRuntime::GetRenderCompleteSemaphore() const {
     return mRenderCompleteSemaphore;
 }
@@ -732,8 +1880,40 @@ VulkanRuntime::GetCooperativeMatrixProperties() const {
     return cooperativeMatrixProperties;
 }
 
+const VkPhysicalDeviceProperties& VulkanRuntime::GetPhysicalDeviceProperties() const {
+    return mPhysicalDeviceProperties2.properties;
+}
+
+const VkPhysicalDeviceVulkan11Properties& VulkanRuntime::GetVulkan11Properties() const {
+    return mVulkan11Properties;
+}
+
+const VkPhysicalDeviceVulkan13Properties& VulkanRuntime::GetVulkan13Properties() const {
+    return mVulkan13Properties;
+}
+
 VulkanBuffer VulkanRuntime::CreateBuffer(
     VkDeviceSize size, VkBufferUsageFlags usageBits,
     VkMemoryPropertyFlags memoryFlagBits) {
     return VulkanBuffer(*this, size, usageBits, memoryFlagBits);
-}
\ No newline at end of file
+}
+
+VulkanMemoryAllocator& VulkanRuntime::GetMemoryAllocator() {
+    return *mMemoryAllocator;
+}
+
+VulkanMemoryStatistics VulkanRuntime::GetMemoryStatistics() const {
+    return mMemoryAllocator->GetStatistics();
+}
+
+VulkanStagingRing& VulkanRuntime::GetStagingRing() {
+    return *mStagingRing;
+}
+
+VulkanPipelineCache& VulkanRuntime::GetPipelineCache() {
+    return *mPipelineCache;
+}
+
+VulkanProfiler VulkanRuntime::CreateProfiler(uint32_t maxRegions) const {
+    return VulkanProfiler(*this, maxRegions);
+}
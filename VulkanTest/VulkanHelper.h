@@ -4,13 +4,27 @@
 #define VULKAN_HELPER_H_
 
 #include <assert.h>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
+#ifndef ARRAYSIZE
+#define ARRAYSIZE(a) (sizeof(a) / sizeof(a[0]))
+#endif
+
 #define VK_CHECK_RESULT(f)                                                                                       \
 {                                                                                                                \
     VkResult res = (f);                                                                                          \
@@ -49,29 +63,279 @@ void RecordBufferBarrier(
     VkAccessFlags dstAccessMask,
     VkDeviceSize size);
 
+// Release (recorded on the source queue) or acquire (recorded on the destination queue) half of a queue family
+// ownership transfer of a whole buffer. The release ignores the destination stage and access mask and the
+// acquire the source ones. Both halves must use the same families.
+void RecordBufferOwnershipTransfer(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkPipelineStageFlagBits srcStage,
+    VkPipelineStageFlagBits dstStage,
+    VkAccessFlags srcAccessMask,
+    VkAccessFlags dstAccessMask,
+    uint32_t srcQueueFamilyIndex,
+    uint32_t dstQueueFamilyIndex);
+
+const char* GetCooperativeMatrixTypeString(VkComponentTypeKHR componentType);
+
+// "<A>_<B>_<C>_<Result>", e.g. "u8_u8_u32_u32".
+std::string GetCooperativeMatrixTypeName(const VkCooperativeMatrixPropertiesKHR& property);
+
 void PrintCooperativeMatrixProperty(VkCooperativeMatrixPropertiesKHR property);
 
+uint32_t GetComponentTypeSize(VkComponentTypeKHR componentType);
+bool IsFloatComponentType(VkComponentTypeKHR componentType);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Element access for buffers of the given component type. Float16 is rounded to nearest even,
+// integers are converted with the usual C++ wrap-around.
+void WriteComponent(void* data, VkComponentTypeKHR componentType, size_t index, double value);
+double ReadComponent(const void* data, VkComponentTypeKHR componentType, size_t index);
+
 class VulkanRuntime;
+class VulkanMemoryAllocator;
+
+enum class VulkanQueueType {
+    Compute,
+    // A transfer-only queue family when the device has one, otherwise the compute queue.
+    Transfer,
+};
+
+// Identifies an asynchronous submission: it has completed once the timeline semaphore of its queue reaches
+// value. The default ticket is always complete.
+struct VulkanSubmitTicket {
+    uint64_t value = 0;
+    VulkanQueueType queueType = VulkanQueueType::Compute;
+};
+
+// A range of a VkDeviceMemory block handed out by VulkanMemoryAllocator.
+struct VulkanAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Non-null when the memory is host visible; blocks stay mapped for their whole lifetime.
+    void* mappedData = nullptr;
+    bool hostCoherent = false;
+    uint32_t memoryTypeIndex = 0;
+    uint32_t blockIndex = 0;
+};
+
+struct VulkanMemoryStatistics {
+    // Live VkDeviceMemory objects and their total size.
+    uint32_t deviceMemoryCount = 0;
+    VkDeviceSize deviceMemoryBytes = 0;
+    // Live sub-allocations and their total size.
+    uint32_t allocationCount = 0;
+    VkDeviceSize allocatedBytes = 0;
+    // Totals since the runtime was created.
+    uint64_t totalAllocations = 0;
+    uint64_t totalDeviceMemoryAllocations = 0;
+    double allocationNanoseconds = 0.0;
+};
+
+// Takes large blocks of device memory per memory type and sub-allocates aligned ranges from them with a
+// first-fit free list, so that creating a buffer rarely calls vkAllocateMemory. Requests larger than half a
+// block get a dedicated VkDeviceMemory. Blocks are kept until the runtime is destroyed.
+class VulkanMemoryAllocator {
+  public:
+    ~VulkanMemoryAllocator();
+    VulkanMemoryAllocator(const VulkanMemoryAllocator&) = delete;
+    VulkanMemoryAllocator& operator=(const VulkanMemoryAllocator&) = delete;
+
+    VulkanAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memoryFlagBits);
+    void Free(const VulkanAllocation& allocation);
+    VulkanMemoryStatistics GetStatistics() const;
+
+    static constexpr VkDeviceSize kBlockSize = 64ull * 1024 * 1024;
+
+  private:
+    friend VulkanRuntime;
+    explicit VulkanMemoryAllocator(const VulkanRuntime& vulkanRuntime);
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mappedData = nullptr;
+        bool dedicated = false;
+        // Free ranges by offset; adjacent ranges are always merged.
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    };
+
+    bool AllocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+    uint32_t CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated);
+
+    const VulkanRuntime& mVulkanRuntime;
+    VkDevice mDevice;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
+    VkDeviceSize mNonCoherentAtomSize = 1;
+
+    mutable std::mutex mMutex;
+    // Indexed by memory type index, then by VulkanAllocation::blockIndex.
+    std::vector<std::vector<Block>> mBlocks;
+    VulkanMemoryStatistics mStatistics;
+};
 
 class VulkanBuffer {
   public:
     ~VulkanBuffer();
+    VulkanBuffer(VulkanBuffer&& other);
+    VulkanBuffer& operator=(VulkanBuffer&& other);
+    VulkanBuffer(const VulkanBuffer&) = delete;
+    VulkanBuffer& operator=(const VulkanBuffer&) = delete;
+
     VkBuffer GetVkBuffer() const;
     VkDeviceMemory GetVkDeviceMemory() const;
+    // Offset of the buffer in GetVkDeviceMemory().
+    VkDeviceSize GetOffset() const;
     VkDeviceSize GetSize() const;
+    // Address for GL_EXT_buffer_reference, or 0 unless the buffer was created with
+    // VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT.
+    VkDeviceAddress GetDeviceAddress() const;
+    // Persistent mapping of the whole buffer, or null if its memory is not host visible.
+    void* GetMappedData() const;
+    // Make host writes visible to the device, and device writes visible to the host, for memory that is
+    // not host coherent. Both are no-ops for coherent memory.
+    void FlushMappedData() const;
+    void InvalidateMappedData() const;
+    // Flushes part of the buffer; offset and size must be multiples of nonCoherentAtomSize unless the range
+    // ends at the end of the buffer.
+    void FlushMappedData(VkDeviceSize offset, VkDeviceSize size) const;
 
   private:
      friend VulkanRuntime;
      VulkanBuffer(
-         const VulkanRuntime& vulkanRuntime,
+         VulkanRuntime& vulkanRuntime,
          VkDeviceSize size,
          VkBufferUsageFlags usageBits,
          VkMemoryPropertyFlags memoryFlagBits);
+    void Release();
 
     VkDevice mDevice;
+    VulkanMemoryAllocator* mAllocator = nullptr;
     VkBuffer mBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory mMemory = VK_NULL_HANDLE;
+    VulkanAllocation mAllocation;
     VkDeviceSize mSize = 0;
+    VkDeviceAddress mDeviceAddress = 0;
+};
+
+struct VulkanProfilerRegion {
+    std::string name;
+    double nanoseconds = 0.0;
+};
+
+// Measures GPU time between pairs of timestamps written into the command buffer.
+// Regions may nest; results are returned in the order the regions were begun.
+class VulkanProfiler {
+  public:
+    ~VulkanProfiler();
+    VulkanProfiler(const VulkanProfiler&) = delete;
+    VulkanProfiler& operator=(const VulkanProfiler&) = delete;
+
+    bool IsSupported() const;
+    void Reset(VkCommandBuffer commandBuffer);
+    void BeginRegion(
+        VkCommandBuffer commandBuffer, const char* name,
+        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    void EndRegion(
+        VkCommandBuffer commandBuffer,
+        VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    // Blocks until every timestamp of the last recording is available.
+    std::vector<VulkanProfilerRegion> GetResults() const;
+
+  private:
+    friend VulkanRuntime;
+    VulkanProfiler(const VulkanRuntime& vulkanRuntime, uint32_t maxRegions);
+
+    VkDevice mDevice;
+    VkQueryPool mQueryPool = VK_NULL_HANDLE;
+    uint32_t mMaxRegions = 0;
+    double mTimestampPeriod = 0.0;
+    uint64_t mTimestampMask = 0;
+
+    std::vector<std::string> mRegionNames;
+    std::vector<uint32_t> mOpenRegions;
+};
+
+// Persistently mapped upload buffer split into segments that are reused round robin. The copy out of every
+// segment is submitted asynchronously, so the host fills one segment while the copies out of the previous
+// ones are still running, and a segment is only overwritten once the ticket of its last copy has
+// completed. Copies go to the runtime queue; later submissions on that queue need a transfer barrier
+// before reading the destination.
+class VulkanStagingRing {
+  public:
+    // Writes size bytes starting at byte offset of the source data to dst.
+    using FillFunction = std::function<void(void* dst, VkDeviceSize offset, VkDeviceSize size)>;
+
+    ~VulkanStagingRing();
+    VulkanStagingRing(const VulkanStagingRing&) = delete;
+    VulkanStagingRing& operator=(const VulkanStagingRing&) = delete;
+
+    // Copies size bytes produced by fill to dstBuffer at dstOffset, splitting the upload into segments.
+    // Returns once the last segment has been submitted.
+    void Upload(const VulkanBuffer& dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, const FillFunction& fill);
+    void Upload(const VulkanBuffer& dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // Blocks until all submitted copies have finished.
+    void Wait();
+
+    VkDeviceSize GetSegmentSize() const;
+    uint32_t GetSegmentCount() const;
+
+  private:
+    friend VulkanRuntime;
+    VulkanStagingRing(VulkanRuntime& vulkanRuntime, VkDeviceSize segmentSize, uint32_t segmentCount);
+
+    VulkanRuntime& mVulkanRuntime;
+    VulkanBuffer mBuffer;
+    VkDeviceSize mSegmentSize;
+    // The last copy out of every segment.
+    std::vector<VulkanSubmitTicket> mSegmentTickets;
+    uint32_t mNextSegment = 0;
+};
+
+struct VulkanPipelineCacheStatistics {
+    // Variants recorded in the loaded cache file.
+    uint32_t loadedVariants = 0;
+    // Pipelines created for variants the cache had already seen, and for new ones.
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    double hitNanoseconds = 0.0;
+    double missNanoseconds = 0.0;
+};
+
+// VkPipelineCache that persists across runs. The file starts with the vendor, device, driver version and
+// pipelineCacheUUID it was written for; a file from any other device or driver is ignored. Next to the
+// driver blob it keeps the keys of every (shader, specialization constants) variant created through it,
+// so callers can tell which variants should be cheap to create.
+class VulkanPipelineCache {
+  public:
+    ~VulkanPipelineCache();
+    VulkanPipelineCache(const VulkanPipelineCache&) = delete;
+    VulkanPipelineCache& operator=(const VulkanPipelineCache&) = delete;
+
+    // Merges the cache stored at path into this one. Returns false if the file is missing or invalid.
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    // Creates a pipeline through the cache and records key as a known variant.
+    VkPipeline CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, const std::string& key);
+    bool HasVariant(const std::string& key) const;
+
+    VkPipelineCache GetVkPipelineCache() const;
+    VulkanPipelineCacheStatistics GetStatistics() const;
+
+  private:
+    friend VulkanRuntime;
+    explicit VulkanPipelineCache(const VulkanRuntime& vulkanRuntime);
+
+    VkDevice mDevice;
+    VkPhysicalDeviceProperties mDeviceProperties;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+
+    mutable std::mutex mMutex;
+    std::set<std::string> mVariants;
+    VulkanPipelineCacheStatistics mStatistics;
 };
 
 class VulkanSwapchain {
@@ -107,16 +371,49 @@ class VulkanSwapchain {
 
 class VulkanRuntime {
   public:
+    // Compute-only runtime: no surface, no swapchain and a compute-capable queue. Returns null when there is no
+    // Vulkan 1.3 instance or no device with VK_KHR_cooperative_matrix.
+    static std::unique_ptr<VulkanRuntime> Create();
+#ifdef _WIN32
     explicit VulkanRuntime(HWND hwnd);
+#endif
     VkDevice GetLogicalDevice() const;
     VkPhysicalDevice GetPhysicalDevice() const;
     VkSurfaceKHR GetSurface() const;
+    bool IsHeadless() const;
 
     VkRenderPass CreateRenderPass(VkFormat colorFormat) const;
     VkPipelineShaderStageCreateInfo LoadShader(const char* filename, VkShaderStageFlagBits stage);
-    VkCommandBuffer CreateAndBeginCommandBuffer() const;
+    // Command buffers come from a pool owned by the calling thread, so threads record concurrently. Command
+    // buffers of retired submissions go back to their pool and are reset and handed out again before new
+    // ones are allocated. A command buffer must be submitted from the thread that created it, and is
+    // submitted to the queue it was created for.
+    VkCommandBuffer CreateAndBeginCommandBuffer(VulkanQueueType queueType = VulkanQueueType::Compute) const;
+    // Returns a command buffer that is not pending to its pool; replayable ones are waited for first.
     void FreeCommandBuffer(VkCommandBuffer commandBuffer) const;
+    // Submits and waits for the command buffer, then recycles it.
     void EndAndFreeCommandBuffer(VkCommandBuffer commandBuffer) const;
+
+    // Ends and submits a command buffer from CreateAndBeginCommandBuffer() without waiting for it; the
+    // command buffer is recycled once the returned ticket has completed. The GPU waits for waitTickets,
+    // which may belong to other queues, before running it. At most kMaxInFlightSubmissions submissions are
+    // pending per queue; beyond that this waits for the oldest one.
+    VulkanSubmitTicket SubmitAsync(
+        VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets = {}) const;
+    // Ends a command buffer from CreateAndBeginCommandBuffer() so that it can be submitted any number of times
+    // with Replay(). It is not recycled; release it with FreeCommandBuffer().
+    void EndReplayableCommandBuffer(VkCommandBuffer commandBuffer) const;
+    // Submits a replayable command buffer again, first waiting for its previous submission to complete.
+    VulkanSubmitTicket Replay(
+        VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets = {}) const;
+    bool IsComplete(VulkanSubmitTicket ticket) const;
+    void Wait(VulkanSubmitTicket ticket) const;
+    // Waits for every asynchronous submission on every queue.
+    void WaitIdle() const;
+    VkSemaphore GetTimelineSemaphore(VulkanQueueType queueType = VulkanQueueType::Compute) const;
+    // Whether storage buffer descriptors can be updated after they were bound in a recorded command buffer.
+    bool SupportsDescriptorUpdateAfterBind() const;
+    static constexpr uint32_t kMaxInFlightSubmissions = 8;
     void QueueSubmit(const std::vector<VkCommandBuffer>& commandBuffers, VkSemaphore waitSemaphore);
 
     VkSemaphore GetRenderCompleteSemaphore() const;
@@ -125,31 +422,107 @@ class VulkanRuntime {
     std::string GetDeviceInfo() const;
 
     VkQueue GetQueue() const;
+    uint32_t GetQueueFamilyIndex() const;
+    uint32_t GetQueueFamilyIndex(VulkanQueueType queueType) const;
+    // Whether transfers run on a transfer-only queue family. Buffers with exclusive sharing then need queue
+    // family ownership transfers between the two queues, see RecordBufferOwnershipTransfer().
+    bool HasDedicatedTransferQueue() const;
+    uint32_t GetTimestampValidBits() const;
+    // SMs, CUs or shader cores as reported by VK_NV_shader_sm_builtins, VK_AMD_shader_core_properties or
+    // VK_ARM_shader_core_builtins, or 0 if the device supports none of them.
+    uint32_t GetComputeUnitCount() const;
 
     uint32_t GetMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryPropertyFlags) const;
 
     std::vector<VkCooperativeMatrixPropertiesKHR> GetCooperativeMatrixProperties() const;
 
+    const VkPhysicalDeviceProperties& GetPhysicalDeviceProperties() const;
+    const VkPhysicalDeviceVulkan11Properties& GetVulkan11Properties() const;
+    const VkPhysicalDeviceVulkan13Properties& GetVulkan13Properties() const;
+
     VulkanBuffer CreateBuffer(
         VkDeviceSize size, VkBufferUsageFlags usageBits,
         VkMemoryPropertyFlags memoryFlagBits);
+    VulkanMemoryAllocator& GetMemoryAllocator();
+    VulkanMemoryStatistics GetMemoryStatistics() const;
+    VulkanStagingRing& GetStagingRing();
+    VulkanPipelineCache& GetPipelineCache();
+
+    VulkanProfiler CreateProfiler(uint32_t maxRegions) const;
 
   private:
+    VulkanRuntime();
+    bool InitializeHeadless();
+    // These print what is missing and return false on failure.
+    bool CreateInstance(const std::vector<const char*>& instanceExtensions);
+    // Only devices that support every one of deviceExtensions are considered.
+    bool PickPhysicalDevice(const std::vector<const char*>& deviceExtensions);
+    bool CreateDevice(const std::vector<const char*>& deviceExtensions);
+
     VkInstance mInstance;
     VkPhysicalDevice mPhysicalDevice;
     VkPhysicalDeviceType mGPUType = VK_PHYSICAL_DEVICE_TYPE_OTHER;
     VkPhysicalDeviceProperties2 mPhysicalDeviceProperties2;
+    VkPhysicalDeviceVulkan11Properties mVulkan11Properties;
+    VkPhysicalDeviceVulkan13Properties mVulkan13Properties;
     VkPhysicalDeviceMemoryProperties mPhysicalDeviceMemoryProperties;
+    uint32_t mComputeUnitCount = 0;
 
     VkDevice mLogicalDevice;
-    VkCommandPool mCommandPool;
+    bool mDescriptorUpdateAfterBind = false;
 
     VkSubmitInfo mSubmitInfo;
     VkQueue mQueue;
+    uint32_t mQueueFamilyIndex = 0;
+    uint32_t mTimestampValidBits = 0;
     VkSemaphore mRenderCompleteSemaphore;
 
-    HWND mHwnd;
-    VkSurfaceKHR mSurface;
+    // Submission state changes in const methods, as submitting does not change what the runtime is.
+    struct ThreadCommandPool {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VulkanQueueType queueType = VulkanQueueType::Compute;
+        // Retired command buffers; they are reset by the owning thread when it takes them.
+        std::vector<VkCommandBuffer> freeCommandBuffers;
+    };
+    struct InFlightSubmission {
+        // Null for replays, which are not recycled.
+        VkCommandBuffer commandBuffer;
+        uint64_t value;
+    };
+    struct SubmitQueue {
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t familyIndex = 0;
+        VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+        uint64_t lastSubmittedValue = 0;
+        std::deque<InFlightSubmission> inFlightSubmissions;
+    };
+    // Callers hold mSubmitMutex.
+    SubmitQueue& GetSubmitQueue(VulkanQueueType queueType) const;
+    ThreadCommandPool* GetThreadCommandPool(VulkanQueueType queueType) const;
+    void RetireSubmissions() const;
+    VulkanSubmitTicket Submit(
+        VkCommandBuffer commandBuffer, const std::vector<VulkanSubmitTicket>& waitTickets, bool recycle) const;
+
+    mutable std::mutex mSubmitMutex;
+    // Indexed by VulkanQueueType; the transfer entry is unused without a dedicated transfer queue.
+    mutable SubmitQueue mSubmitQueues[2];
+    bool mDedicatedTransferQueue = false;
+    // Keyed by thread and queue family. Pools of threads that have exited are kept until the runtime is
+    // destroyed.
+    mutable std::map<std::pair<std::thread::id, uint32_t>, std::unique_ptr<ThreadCommandPool>> mThreadCommandPools;
+    mutable std::unordered_map<VkCommandBuffer, ThreadCommandPool*> mCommandBufferPools;
+    // Last submission of every replayable command buffer.
+    mutable std::unordered_map<VkCommandBuffer, uint64_t> mReplayValues;
+
+    std::unique_ptr<VulkanMemoryAllocator> mMemoryAllocator;
+    // Declared after the allocator so that its buffer is released first.
+    std::unique_ptr<VulkanStagingRing> mStagingRing;
+    std::unique_ptr<VulkanPipelineCache> mPipelineCache;
+
+#ifdef _WIN32
+    HWND mHwnd = nullptr;
+#endif
+    VkSurfaceKHR mSurface = VK_NULL_HANDLE;
 
     const VkPipelineStageFlags kSubmitPipelineStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 };
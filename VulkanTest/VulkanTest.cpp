@@ -1,208 +1,238 @@
+#include "Autotuner.h"
+#include "Benchmark.h"
+#include "CpuGemm.h"
+#include "GemmBenchmark.h"
+#include "GemmKernel.h"
+#include "PipelineRegistry.h"
+#include "ThreadPool.h"
 #include "VulkanHelper.h"
-#include "Window.h"
 
-#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <set>
 
-int main() {
-    HWND hwnd = CreateAppWindow();
-    VulkanRuntime vulkanRuntime(hwnd);
+namespace {
+    // Skipped results were never measured, so they stay out of the table, the reports and the checks.
+    void AddResult(const BenchmarkResult& result, std::vector<BenchmarkResult>* results) {
+        if (!result.skipped) {
+            results->push_back(result);
+        }
+    }
 
-    const auto& cooperativeMatrixProperties = vulkanRuntime.GetCooperativeMatrixProperties();
-    VkCooperativeMatrixPropertiesKHR uint8Property = {};
-    for (const auto& property : cooperativeMatrixProperties) {
-        if (property.scope != VK_SCOPE_SUBGROUP_KHR) {
-            continue;
+    // Every shape runs the kernel tuned for its shape class, searched first when the database does not have it
+    // or has one that cannot run this particular shape.
+    void RunTunedGpuBenchmarks(
+        VulkanRuntime& vulkanRuntime, const BenchmarkOptions& options,
+        const std::vector<VkCooperativeMatrixPropertiesKHR>& properties, std::vector<BenchmarkResult>* results) {
+        AutotuneDatabase database(vulkanRuntime);
+        if (!database.Load(options.autotunePath)) {
+            printf("Error: failed to read %s, starting an empty autotuning database\n", options.autotunePath.c_str());
         }
-        PrintCooperativeMatrixProperty(property);
-        if (uint8Property.KSize == 0 && property.AType == VK_COMPONENT_TYPE_UINT8_KHR) {
-            uint8Property = property;
+        ThreadPool threadPool;
+        PipelineRegistry pipelineRegistry(vulkanRuntime, threadPool);
+        bool databaseChanged = false;
+        for (const VkCooperativeMatrixPropertiesKHR& property : properties) {
+            for (const GemmShape& shape : GetBenchmarkShapes(options, property)) {
+                AutotuneKey key = MakeAutotuneKey(property, shape, options);
+                GemmKernelConfig config = options.kernelConfig;
+                std::unique_ptr<GemmKernel> gemmKernel;
+                if (!options.retune && database.Find(key, &config)) {
+                    gemmKernel = std::make_unique<GemmKernel>(vulkanRuntime, property, config);
+                    if (gemmKernel->IsShapeSupported(shape)) {
+                        printf("Tuned %s/%s/%s: %s\n", key.type.c_str(), key.tile.c_str(), key.shapeClass.c_str(),
+                            GetAutotuneParameterName(config).c_str());
+                    } else {
+                        gemmKernel.reset();
+                    }
+                }
+                if (!gemmKernel) {
+                    AutotuneEntry entry;
+                    if (!AutotuneGemmKernel(vulkanRuntime, pipelineRegistry, property, shape, options, &entry)) {
+                        printf("Skipping %s: no %s kernel with %ux%ux%u %s tiles can be tuned for it\n",
+                            GetShapeName(shape).c_str(), GemmKernel::GetKernelName(options.kernelConfig).c_str(),
+                            property.MSize, property.NSize, property.KSize,
+                            GemmKernel::GetShaderVariantName(property).c_str());
+                        continue;
+                    }
+                    database.Store(entry);
+                    databaseChanged = true;
+                    gemmKernel = std::make_unique<GemmKernel>(vulkanRuntime, property, entry.config);
+                }
+                GemmKernel::CreatePipelines(pipelineRegistry, { gemmKernel.get() });
+                if (options.groupCount > 0) {
+                    AddResult(RunGroupedGemmBenchmark(vulkanRuntime, *gemmKernel, shape, options), results);
+                } else {
+                    AddResult(RunGemmBenchmark(vulkanRuntime, *gemmKernel, shape, options), results);
+                }
+            }
+        }
+        if (databaseChanged && !database.Save(options.autotunePath)) {
+            printf("Error: failed to write %s\n", options.autotunePath.c_str());
         }
     }
-    if (uint8Property.KSize == 0) {
-        printf("Error: no uint8 cooperative matrix supported\n");
-        return 0;
-    }
-    printf("\nChoose config:\n");
-    PrintCooperativeMatrixProperty(uint8Property);
-    printf("\n");
-
-    VkDevice device = vulkanRuntime.GetLogicalDevice();
-
-    VkDeviceSize uploadBufferSize = static_cast<VkDeviceSize>(
-        uint8Property.KSize * uint8Property.MSize + uint8Property.KSize * uint8Property.NSize);
-    VulkanBuffer uploadBuffer = vulkanRuntime.CreateBuffer(
-        uploadBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    VkDeviceSize inputBufferSize1 = uint8Property.KSize * uint8Property.MSize;
-    VkDeviceSize inputBufferSize2 = uint8Property.KSize * uint8Property.NSize;
-    VkDeviceSize outputBufferSize = uint8Property.MSize * uint8Property.NSize * 4;
-    VkDeviceSize readbackBufferSize = outputBufferSize;
-    VulkanBuffer inputBuffer1 = vulkanRuntime.CreateBuffer(
-        inputBufferSize1, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VulkanBuffer inputBuffer2 = vulkanRuntime.CreateBuffer(
-        inputBufferSize2, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VulkanBuffer outputBuffer = vulkanRuntime.CreateBuffer(
-        outputBufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VulkanBuffer readbackBuffer = vulkanRuntime.CreateBuffer(
-        outputBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-
-    VkDeviceMemory uploadMemory = uploadBuffer.GetVkDeviceMemory();
-    void* uploadPtr;
-    VK_CHECK_RESULT(vkMapMemory(device, uploadMemory, 0, VK_WHOLE_SIZE, 0, &uploadPtr));
-    uint8_t* uploadUint32Ptr = static_cast<uint8_t*>(uploadPtr);
-    memset(uploadPtr, 1u, uploadBufferSize);
-    vkUnmapMemory(device, uploadMemory);
-
-    VkDescriptorPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolCreateInfo.maxSets = 3;
-    VkDescriptorPoolSize poolSize = {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSize.descriptorCount = 3;
-    poolCreateInfo.poolSizeCount = 1;
-    poolCreateInfo.pPoolSizes = &poolSize;
-    VkDescriptorPool descriptorPool;
-    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool));
-
-    std::array<VkDescriptorSetLayoutBinding, 3> bindingDescs = {};
-    bindingDescs[0].binding = 0;
-    bindingDescs[0].descriptorCount = 1;
-    bindingDescs[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindingDescs[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    bindingDescs[2] = bindingDescs[1] = bindingDescs[0];
-    bindingDescs[1].binding = 1;
-    bindingDescs[2].binding = 2;
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
-    descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindingDescs.size());
-    descriptorSetLayoutCreateInfo.pBindings = bindingDescs.data();
-    VkDescriptorSetLayout descriptorSetLayout;
-    VK_CHECK_RESULT(
-        vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout));
 
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
-    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
-    VkDescriptorSet descriptorSet;
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
-
-    std::array<VkWriteDescriptorSet, 3> writeDescriptorSets = {};
-    writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSets[0].dstSet = descriptorSet;
-    writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    writeDescriptorSets[0].descriptorCount = 1;
-    VkDescriptorBufferInfo bufferInfo1 = {};
-    bufferInfo1.buffer = inputBuffer1.GetVkBuffer();
-    bufferInfo1.offset = 0;
-    bufferInfo1.range = VK_WHOLE_SIZE;
-    writeDescriptorSets[0].dstBinding = 0;
-    writeDescriptorSets[0].pBufferInfo = &bufferInfo1;
-    VkDescriptorBufferInfo bufferInfo2 = {};
-    bufferInfo2.buffer = inputBuffer2.GetVkBuffer();
-    bufferInfo2.offset = 0;
-    bufferInfo2.range = VK_WHOLE_SIZE;
-    writeDescriptorSets[1] = writeDescriptorSets[0];
-    writeDescriptorSets[1].dstBinding = 1;
-    writeDescriptorSets[1].pBufferInfo = &bufferInfo2;
-    VkDescriptorBufferInfo bufferInfo3 = {};
-    bufferInfo3.buffer = outputBuffer.GetVkBuffer();
-    bufferInfo3.offset = 0;
-    bufferInfo3.range = VK_WHOLE_SIZE;
-    writeDescriptorSets[2] = writeDescriptorSets[0];
-    writeDescriptorSets[2].dstBinding = 2;
-    writeDescriptorSets[2].pBufferInfo = &bufferInfo3;
-    vkUpdateDescriptorSets(
-        device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(),
-        0, nullptr);
-
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 1;
-    pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayout;
-    VkPipelineLayout pipelineLayout;
-    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
-
-    uint32_t constantData[] = { uint8Property.MSize, uint8Property.NSize, uint8Property.KSize };
-    VkPipelineShaderStageCreateInfo shaderStageCreateInfo =
-        vulkanRuntime.LoadShader("Shaders/compute_nv.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
-    VkSpecializationMapEntry entry = {};
-    VkSpecializationMapEntry entries[] = {
-        {0, sizeof(uint32_t) * 0, sizeof(uint32_t)},
-        {1, sizeof(uint32_t) * 1, sizeof(uint32_t)},
-        {2, sizeof(uint32_t) * 2, sizeof(uint32_t)},
-    };
-    VkSpecializationInfo specInfo =
-    {
-        ARRAYSIZE(constantData),
-        entries,
-        sizeof(constantData),
-        constantData,
-    };
-    VkComputePipelineCreateInfo computePipelineCreateInfo = {};
-    computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    computePipelineCreateInfo.stage = shaderStageCreateInfo;
-    computePipelineCreateInfo.stage.pSpecializationInfo = &specInfo;
-    computePipelineCreateInfo.layout = pipelineLayout;
-    VkPipeline computePipeline;
-    VK_CHECK_RESULT(vkCreateComputePipelines(
-        device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &computePipeline));
-
-    VkCommandBuffer commandBuffer = vulkanRuntime.CreateAndBeginCommandBuffer();
-    VkBufferCopy bufferCopy = {};
-    bufferCopy.dstOffset = 0;
-    bufferCopy.srcOffset = 0;
-    bufferCopy.size = inputBuffer1.GetSize();
-    vkCmdCopyBuffer(
-        commandBuffer, uploadBuffer.GetVkBuffer(), inputBuffer1.GetVkBuffer(), 1, &bufferCopy);
-    bufferCopy.size = inputBuffer2.GetSize();
-    vkCmdCopyBuffer(
-        commandBuffer, uploadBuffer.GetVkBuffer(), inputBuffer2.GetVkBuffer(), 1, &bufferCopy);
+    void RunGpuBenchmarks(
+        VulkanRuntime& vulkanRuntime, const BenchmarkOptions& options, std::vector<BenchmarkResult>* results,
+        bool* anySelected) {
+        // Benchmark the first supported property of every type combination that passes the type filter,
+        // or all of them when sweeping.
+        std::vector<VkCooperativeMatrixPropertiesKHR> selectedProperties;
+        std::set<std::string> selectedTypes;
+        for (const auto& property : vulkanRuntime.GetCooperativeMatrixProperties()) {
+            if (property.scope != VK_SCOPE_SUBGROUP_KHR) {
+                continue;
+            }
+            PrintCooperativeMatrixProperty(property);
+            std::string typeName = GemmKernel::GetShaderVariantName(property);
+            if (!GemmKernel::IsPropertySupported(property) || !MatchesTypeFilter(options, typeName) ||
+                !GemmKernel::IsEpilogueSupported(property, options.kernelConfig.epilogue) ||
+                (options.kernelConfig.int4GroupSize != 0 &&
+                    !GemmKernel::IsInt4WeightsSupported(property, options.kernelConfig.int4GroupSize)) ||
+                (!selectedTypes.insert(typeName).second && !options.sweep)) {
+                continue;
+            }
+            selectedProperties.push_back(property);
+        }
+        printf("\n");
+        *anySelected = !selectedProperties.empty();
+        if (!options.autotunePath.empty()) {
+            RunTunedGpuBenchmarks(vulkanRuntime, options, selectedProperties, results);
+            return;
+        }
 
-    RecordBufferBarrier(
-        commandBuffer, inputBuffer1.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
-        VK_ACCESS_SHADER_READ_BIT, inputBuffer1.GetSize());
-    RecordBufferBarrier(
-        commandBuffer, inputBuffer2.GetVkBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
-        VK_ACCESS_SHADER_READ_BIT, inputBuffer2.GetSize());
+        // Compile every pipeline up front, concurrently, before anything is measured.
+        std::vector<std::unique_ptr<GemmKernel>> gemmKernels;
+        std::vector<GemmKernel*> pendingKernels;
+        for (const VkCooperativeMatrixPropertiesKHR& property : selectedProperties) {
+            gemmKernels.push_back(std::make_unique<GemmKernel>(vulkanRuntime, property, options.kernelConfig));
+            pendingKernels.push_back(gemmKernels.back().get());
+        }
+        ThreadPool threadPool;
+        PipelineRegistry pipelineRegistry(vulkanRuntime, threadPool);
+        auto compileStart = std::chrono::steady_clock::now();
+        GemmKernel::CreatePipelines(pipelineRegistry, pendingKernels);
+        printf("Compiled %zu pipelines from %u shaders on %u threads in %.3f ms\n\n", pendingKernels.size(),
+            pipelineRegistry.GetShaderModuleCount(), threadPool.GetThreadCount(),
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count());
+
+        for (const std::unique_ptr<GemmKernel>& gemmKernelPointer : gemmKernels) {
+            GemmKernel& gemmKernel = *gemmKernelPointer;
+            const VkCooperativeMatrixPropertiesKHR& property = gemmKernel.GetProperty();
+            for (const GemmShape& shape : GetBenchmarkShapes(options, property)) {
+                if (!gemmKernel.IsShapeSupported(shape)) {
+                    printf("Skipping %s: not supported by the %s kernel with %ux%ux%u %s tiles\n",
+                        GetShapeName(shape).c_str(), gemmKernel.GetKernelName().c_str(),
+                        property.MSize, property.NSize, property.KSize,
+                        GemmKernel::GetShaderVariantName(property).c_str());
+                    continue;
+                }
+                if (options.groupCount > 0) {
+                    AddResult(RunGroupedGemmBenchmark(vulkanRuntime, gemmKernel, shape, options), results);
+                } else {
+                    AddResult(RunGemmBenchmark(vulkanRuntime, gemmKernel, shape, options), results);
+                }
+            }
+        }
+    }
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    void RunCpuBenchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>* results) {
+        ThreadPool threadPool(options.cpuThreads);
+        printf("CPU backend: %s microkernels, %u threads\n", GetCpuGemmIsaName(options.cpuIsa),
+            threadPool.GetThreadCount());
+        for (const VkCooperativeMatrixPropertiesKHR& property : CpuGemm::GetSupportedProperties()) {
+            if (!MatchesTypeFilter(options, GetCooperativeMatrixTypeName(property))) {
+                continue;
+            }
+            CpuGemm cpuGemm(threadPool, property, options.cpuIsa);
+            for (const GemmShape& shape : GetBenchmarkShapes(options, property)) {
+                results->push_back(RunCpuGemmBenchmark(cpuGemm, shape, options));
+            }
+        }
+    }
+}  // anonymous namespace
 
-    RecordBufferBarrier(
-        commandBuffer, outputBuffer.GetVkBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
-        VK_ACCESS_SHADER_READ_BIT, outputBuffer.GetSize());
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!ParseBenchmarkOptions(argc, argv, &options)) {
+        PrintBenchmarkUsage();
+        return 1;
+    }
 
-    bufferCopy.size = outputBuffer.GetSize();
-    vkCmdCopyBuffer(commandBuffer, outputBuffer.GetVkBuffer(), readbackBuffer.GetVkBuffer(), 1, &bufferCopy);
-    vulkanRuntime.EndAndFreeCommandBuffer(commandBuffer);
+    std::vector<BenchmarkResult> results;
+    std::unique_ptr<VulkanRuntime> vulkanRuntime;
+    bool runCpu = options.backend != BenchmarkBackend::Gpu;
+    if (options.backend != BenchmarkBackend::Cpu) {
+        vulkanRuntime = VulkanRuntime::Create();
+        if (!vulkanRuntime) {
+            printf("No Vulkan device supports cooperative matrices, falling back to the CPU\n");
+            runCpu = true;
+        }
+    }
+    if (vulkanRuntime) {
+        VulkanPipelineCache& pipelineCache = vulkanRuntime->GetPipelineCache();
+        if (!options.pipelineCachePath.empty()) {
+            pipelineCache.Load(options.pipelineCachePath);
+        }
+        bool anySelected = false;
+        RunGpuBenchmarks(*vulkanRuntime, options, &results, &anySelected);
+        if (!options.pipelineCachePath.empty() && !pipelineCache.Save(options.pipelineCachePath)) {
+            printf("Error: failed to write %s\n", options.pipelineCachePath.c_str());
+        }
+        if (!anySelected) {
+            printf("No supported cooperative matrix type matches the type filter, falling back to the CPU\n");
+            runCpu = true;
+        }
+    }
+    if (runCpu) {
+        RunCpuBenchmarks(options, &results);
+    }
+    if (results.empty()) {
+        printf("Error: nothing to benchmark\n");
+        return 0;
+    }
+    printf("\n");
+    PrintBenchmarkTable(results);
+    if (options.sweep) {
+        PrintBestConfigurations(results);
+    }
+    if (vulkanRuntime) {
+        VulkanMemoryStatistics statistics = vulkanRuntime->GetMemoryStatistics();
+        printf("\nDevice memory: %u blocks (%.1f MB), %llu buffer allocations in %.3f ms\n",
+            statistics.deviceMemoryCount, statistics.deviceMemoryBytes / (1024.0 * 1024.0),
+            static_cast<unsigned long long>(statistics.totalAllocations), statistics.allocationNanoseconds * 1e-6);
+        VulkanPipelineCacheStatistics cacheStatistics = vulkanRuntime->GetPipelineCache().GetStatistics();
+        printf("Pipelines: %u cached variants loaded, %u hits in %.3f ms, %u misses in %.3f ms\n",
+            cacheStatistics.loadedVariants, cacheStatistics.hits, cacheStatistics.hitNanoseconds * 1e-6,
+            cacheStatistics.misses, cacheStatistics.missNanoseconds * 1e-6);
+    }
 
-    VkDeviceMemory readbackMemory = readbackBuffer.GetVkDeviceMemory();
-    void* readbackPtr;
-    VK_CHECK_RESULT(vkMapMemory(device, readbackMemory, 0, VK_WHOLE_SIZE, 0, &readbackPtr));
+    if (!options.jsonPath.empty() && !WriteJsonReport(options.jsonPath, vulkanRuntime.get(), results)) {
+        printf("Error: failed to write %s\n", options.jsonPath.c_str());
+        return 1;
+    }
+    if (!options.csvPath.empty() && !WriteCsvReport(options.csvPath, vulkanRuntime.get(), results)) {
+        printf("Error: failed to write %s\n", options.csvPath.c_str());
+        return 1;
+    }
 
-    printf("Output data (column major): \n");
+    for (const BenchmarkResult& result : results) {
+        if (!result.verified) {
+            printf("Error: %s produced wrong results\n", result.name.c_str());
+            return 1;
+        }
+    }
 
-    uint32_t* result = static_cast<uint32_t*>(readbackPtr);
-    for (uint32_t y = 0; y < uint8Property.MSize; ++y) {
-        for (uint32_t x = 0; x < uint8Property.NSize; ++x) {
-            uint32_t index = y * uint8Property.NSize + x;
-            printf("%d ", result[index]);
+    if (!options.baselinePath.empty()) {
+        int regressionCount = CompareWithBaseline(options.baselinePath, results, options.regressionThreshold);
+        if (regressionCount < 0) {
+            printf("Error: failed to read baseline %s\n", options.baselinePath.c_str());
+            return 1;
+        }
+        if (regressionCount > 0) {
+            return 2;
         }
-        printf("\n");
     }
-    printf("\n");
 
     return 0;
 }